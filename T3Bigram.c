@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#include <string.h>
+#include "T3Bigram.h"
+
+#define _T3_BIGRAM_VERSION 1
+
+uint16_t _t3_read16(const uint8_t * data);
+
+bool t3bigram_init(T3Bigram * bigram, const uint8_t * data, size_t size) {
+	if(size < T3_BIGRAM_HEADER_BYTES || memcmp(data, "T3B", 3) != 0 || data[3] != _T3_BIGRAM_VERSION
+		|| data[4] < 1 || data[4] > T3_BIGRAM_MAX_NEXT)
+		return false;
+	
+	bigram->next = data[4];
+	bigram->bucketCount = _t3_read16(&data[6]);
+	bigram->entryCount = _t3_read16(&data[8]);
+	bigram->vocabSize = _t3_read16(&data[10]);
+	
+	// The bucket count is a power of two with room to spare, so probing
+	// usually ends at an empty bucket within a step or two
+	size_t entryBytes = 2 + 3 * bigram->next;
+	if(bigram->bucketCount == 0 || (bigram->bucketCount & (bigram->bucketCount - 1)) != 0
+		|| bigram->entryCount >= bigram->bucketCount
+		|| size != T3_BIGRAM_HEADER_BYTES + 2u * bigram->bucketCount
+			+ entryBytes * bigram->entryCount + bigram->vocabSize
+		|| bigram->vocabSize == 0 || data[size - 1] != '\0')
+		return false;
+	
+	bigram->buckets = &data[T3_BIGRAM_HEADER_BYTES];
+	bigram->entries = bigram->buckets + 2 * bigram->bucketCount;
+	bigram->vocab = (const char*)(bigram->entries + entryBytes * bigram->entryCount);
+	return true;
+}
+
+uint32_t t3bigram_hash(const char * word, uint8_t length) {
+	uint32_t hash = 2166136261u;
+	for(uint8_t i = 0; i < length; ++i) {
+		uint8_t c = (uint8_t)word[i];
+		if(c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		hash = (hash ^ c) * 16777619u;
+	}
+	return hash;
+}
+
+uint8_t t3bigram_predict(const T3Bigram * bigram, const char * text, uint8_t length,
+						 T3Candidate * candidates, uint8_t max) {
+	if(length == 0 || strchr(T3_WORD_SEPARATORS, text[length - 1]) == NULL)
+		return 0;
+	
+	// The previous word ends before the separators at the end of the text
+	uint8_t end = length;
+	while(end > 0 && strchr(T3_WORD_SEPARATORS, text[end - 1]) != NULL)
+		--end;
+	uint8_t start = end;
+	while(start > 0 && strchr(T3_WORD_SEPARATORS, text[start - 1]) == NULL)
+		--start;
+	if(start == end)
+		return 0;
+	
+	uint32_t hash = t3bigram_hash(&text[start], end - start);
+	uint16_t check = hash >> 16;
+	uint16_t bucket = hash & (bigram->bucketCount - 1);
+	for(uint16_t probes = 0; probes < bigram->bucketCount; ++probes) {
+		uint16_t entry = _t3_read16(&bigram->buckets[2 * bucket]);
+		if(entry >= bigram->entryCount)
+			return 0;
+		
+		const uint8_t * data = &bigram->entries[entry * (2 + 3 * bigram->next)];
+		if(_t3_read16(data) == check) {
+			uint8_t found = 0;
+			for(uint8_t i = 0; i < bigram->next && found < max; ++i) {
+				uint16_t offset = _t3_read16(&data[2 + 3 * i]);
+				if(offset >= bigram->vocabSize || data[4 + 3 * i] > T3_BIGRAM_MAX_SCORE)
+					break;
+				candidates[found].text = &bigram->vocab[offset];
+				candidates[found].replace = 0;
+				++found;
+			}
+			return found;
+		}
+		bucket = (bucket + 1) & (bigram->bucketCount - 1);
+	}
+	return 0;  // Every bucket is taken, which only a damaged table can do
+}
+
+uint16_t _t3_read16(const uint8_t * data) {
+	return data[0] | (data[1] << 8);
+}
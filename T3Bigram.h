@@ -0,0 +1,102 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#ifndef T3_BIGRAM_H
+#define T3_BIGRAM_H
+
+#include "T3Core.h"
+
+/**
+ * The most likely next words stored for each previous word.
+ */
+#define T3_BIGRAM_MAX_NEXT 3
+
+/**
+ * The highest score of a next word that is offered, where a word with
+ * probability p scores -16 * log2(p). The default of 80 offers words that
+ * follow at least one time in 32.
+ */
+#define T3_BIGRAM_MAX_SCORE 80
+
+/**
+ * The size of the header of a bigram table, in bytes.
+ */
+#define T3_BIGRAM_HEADER_BYTES 12
+
+#define _T3_BIGRAM_NONE 0xFFFF
+
+/**
+ * A read-only table of the most likely words to follow a previous word, as
+ * written by host/t3bigram.c. All numbers are little-endian:
+ *
+ *    header := "T3B" version next reserved buckets:u16 entries:u16 vocab:u16
+ *    buckets := u16 * buckets    (an entry index, or 0xFFFF if empty)
+ *    entries := (check:u16 (word:u16 score:u8) * next) * entries
+ *    vocab := (any UTF-8 word, then \0) *
+ *
+ * A previous word is found by the FNV-1a hash of its ASCII-lowercased bytes,
+ * from t3bigram_hash(): the low bits pick the first bucket, probing onwards
+ * to the first empty one, and the high 16 bits are the check. Each next
+ * word is a byte offset into vocab, best first, with its probability p
+ * quantized to a score of -16 * log2(p). Unused slots are 0xFFFF.
+ * Next words scoring above T3_BIGRAM_MAX_SCORE are not offered.
+ */
+typedef struct T3Bigram {
+	const uint8_t * buckets;
+	const uint8_t * entries;
+	const char * vocab;
+	uint16_t bucketCount;
+	uint16_t entryCount;
+	uint16_t vocabSize;
+	uint8_t next;
+} T3Bigram;
+
+/**
+ * Initializes a T3Bigram from a table in memory.
+ *
+ * @param bigram  The T3Bigram to initialize.
+ * @param data  The table. It is not copied and must outlive the T3Bigram.
+ * @param size  The size of the table in bytes.
+ * @return Whether the table is valid.
+ */
+bool t3bigram_init(T3Bigram * bigram, const uint8_t * data, size_t size);
+
+/**
+ * Hashes a word as the table is keyed.
+ *
+ * @param word  The word. It need not be terminated.
+ * @param length  The length of the word in bytes.
+ * @return The FNV-1a hash of the word with ASCII letters lowercased.
+ */
+uint32_t t3bigram_hash(const char * word, uint8_t length);
+
+/**
+ * Finds the most likely words to follow the last word of a text, if the
+ * text ends with one of T3_WORD_SEPARATORS.
+ *
+ * @param bigram  The T3Bigram to search.
+ * @param text  The text being entered.
+ * @param length  The length of the text in bytes.
+ * @param candidates  The array to fill with the next words, best first.
+ * @param max  The size of the candidates array.
+ * @return The number of candidates found.
+ */
+uint8_t t3bigram_predict(const T3Bigram * bigram, const char * text, uint8_t length,
+						 T3Candidate * candidates, uint8_t max);
+
+#endif
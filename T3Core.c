@@ -0,0 +1,803 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#include <string.h>
+#include "T3Core.h"
+#include "T3Mru.h"
+#include "T3Snippets.h"
+#include "T3Words.h"
+#include "T3Bigram.h"
+
+#if T3_INCLUDE_LAYOUT_LOWERCASE
+const char T3_LAYOUT_LOWERCASE[] =
+	"abc\0"  "def\0"  "ghi\0"
+	"jkl\0"  "mno\0"  "pqr\0"
+	"stu\0"  "vwx\0"  "yz \0";
+#endif
+
+#if T3_INCLUDE_LAYOUT_UPPERCASE
+const char T3_LAYOUT_UPPERCASE[] =
+	"ABC\0"  "DEF\0"  "GHI\0"
+	"JKL\0"  "MNO\0"  "PQR\0"
+	"STU\0"  "VWX\0"  "YZ \0";
+#endif
+
+#if T3_INCLUDE_LAYOUT_NUMBERS
+const char T3_LAYOUT_NUMBERS[] =
+	"01\0"  "2\0"  "3\0"
+	"4\0"   "5\0"  "6\0"
+	"7\0"   "8\0"  "9\0";
+#endif
+
+#if T3_INCLUDE_LAYOUT_PUNC
+const char T3_LAYOUT_PUNC[] =
+	".\0"  "'!\0"  ":;\"\0"
+	",\0"  "-\0"   "@$#\0"
+	"?\0"  "&%\0"  "+*=\0";
+#endif
+
+#if T3_INCLUDE_LAYOUT_BRACKETS
+const char T3_LAYOUT_BRACKETS[] =
+	"()\0"  "<>\0"   "{}\0"
+	"/\0"   "\\\0"   "[]\0"
+	"|_\0"  "~^`\0"  "¢½\0";
+#endif
+
+#if T3_INCLUDE_LAYOUT_LOWERCASE_EXTENDED
+const char T3_LAYOUT_LOWERCASE_EXTENDED[] = T3_GRID_4X3
+	"abc\0"  "def\0"  "ghi\0"
+	"jkl\0"  "mno\0"  "pqr\0"
+	"stu\0"  "vwx\0"  "yz \0"
+	".,?\0"  "'!-\0"  "@:;\0";
+#endif
+
+#define _T3_MODE_TIMEOUT_IN_MS 600
+#define _T3_SNAPSHOT_VERSION 1
+#define _T3_SNAPSHOT_SELECTION 0x01
+#define _T3_SNAPSHOT_PENDING 0x02
+
+void _t3_transition(T3Core * core, T3Event event);
+void _t3_click(T3Core * core, uint8_t button, uint32_t time);
+void _t3_twoStepClick(T3Core * core, uint8_t button);
+void _t3_longclick(T3Core * core, uint8_t button);
+void _t3_back(T3Core * core);
+void _t3_backspace(T3Core * core);
+void _t3_timeout(T3Core * core, uint32_t time);
+void _t3_open(T3Core * core);
+void _t3_pick(T3Core * core, uint8_t index);
+void _t3_updateCandidates(T3Core * core);
+uint8_t _t3_currentCandidateCount(T3Core * core);
+void _t3_expand(T3Core * core);
+void _t3_learnSnippets(T3Core * core);
+void _t3_countCommits(T3Core * core, uint8_t count);
+void _t3_toggleMode(T3Core * core);
+bool _t3_addChar(T3Core * core, const char * c);
+bool _t3_loadKeyboard(T3Core * core);
+const char * _t3_getCharGroup(const T3Core * core, int row, int col);
+void _t3_markKey(T3Core * core, uint8_t row, uint8_t col);
+uint8_t _t3_firstRow(const T3Core * core, uint8_t button);
+uint8_t _t3_rowButton(const T3Core * core, uint8_t row);
+uint8_t _t3_utf8CharLength(const char * c);
+uint8_t _t3_utf8Truncate(const char * text, uint8_t maxBytes);
+uint8_t _t3_utf8Count(const char * text, uint8_t length);
+
+bool t3core_init(T3Core * core,
+				 const char ** set1, uint8_t count1,
+				 const char ** set2, uint8_t count2,
+				 const char ** set3, uint8_t count3) {
+	if(set1 != NULL && count1 > 0)
+		core->set = 0;
+	else if(set2 != NULL && count2 > 0)
+		core->set = 1;
+	else if(set3 != NULL && count3 > 0)
+		core->set = 2;
+	else
+		core->set = 3;
+	
+	core->keyboardSets[0] = set1;
+	core->keyboardSets[1] = set2;
+	core->keyboardSets[2] = set3;
+	core->keyboardCounts[0] = count1;
+	core->keyboardCounts[1] = count2;
+	core->keyboardCounts[2] = count3;
+	core->kb = 0;
+	core->row = 0;
+	core->col = 0;
+	core->rows = 0;
+	core->cols = 0;
+	core->entryMode = T3_ENTRY_MULTITAP;
+	core->selectionMode = false;
+	core->pickMode = false;
+	core->timerPending = false;
+	core->deadline = 0;
+	core->eventHead = 0;
+	core->eventCount = 0;
+	for(uint8_t i = 0; i < _T3_MAX_CHARS_PER_KEY; ++i)
+		core->singleChars[i][0] = '\0';
+	for(uint8_t i = 0; i <= T3_MAXLENGTH; ++i)
+		core->inputString[i] = '\0';
+	core->inputLength = 0;
+	core->expandedEnd = 0;
+	core->mru = NULL;
+	core->snippets = NULL;
+	core->words = NULL;
+	core->bigram = NULL;
+	core->candidateCount = 0;
+	core->candidatesDismissed = false;
+	#if T3_COLLECT_STATS
+	core->stats.wakeups = 0;
+	core->stats.timerOps = 0;
+	core->stats.redraws = 0;
+	core->stats.commits = 0;
+	#endif
+	
+	bool valid = _t3_loadKeyboard(core);
+	
+	// The backend lays out the initial grid itself
+	core->effects.dirty = 0;
+	core->effects.dirtyKeys = 0;
+	core->effects.commits = 0;
+	core->effects.close = false;
+	
+	return valid;
+}
+
+bool t3core_post(T3Core * core, uint8_t type, uint8_t button, uint32_t time) {
+	if(core->eventCount >= _T3_EVENT_QUEUE_SIZE)
+		return false;
+	
+	// The button picks a row of the keyboard tables, so no other is queued
+	if((type == T3_EVENT_CLICK || type == T3_EVENT_LONGCLICK)
+		&& (button < T3_BUTTON_UP || button > T3_BUTTON_DOWN))
+		return false;
+	
+	uint8_t tail = (core->eventHead + core->eventCount) % _T3_EVENT_QUEUE_SIZE;
+	core->events[tail].type = type;
+	core->events[tail].button = button;
+	core->events[tail].time = time;
+	++(core->eventCount);
+	return true;
+}
+
+void t3core_run(T3Core * core, T3Effects * effects) {
+	while(core->eventCount > 0) {
+		T3Event event = core->events[core->eventHead];
+		core->eventHead = (core->eventHead + 1) % _T3_EVENT_QUEUE_SIZE;
+		--(core->eventCount);
+		_t3_transition(core, event);
+	}
+	
+	// Candidates follow the text, so they are looked up once per batch
+	if(core->effects.dirty & T3_DIRTY_INPUT)
+		_t3_updateCandidates(core);
+	
+	*effects = core->effects;
+	effects->timerWanted = core->timerPending;
+	effects->deadline = core->deadline;
+	
+	core->effects.dirty = 0;
+	core->effects.dirtyKeys = 0;
+	core->effects.commits = 0;
+	core->effects.close = false;
+}
+
+void t3core_set_text(T3Core * core, const char * text) {
+	// Never keep a partial code point at the end of a truncated text
+	core->inputLength = _t3_utf8Truncate(text, T3_MAXLENGTH);
+	memcpy(core->inputString, text, core->inputLength);
+	core->inputString[core->inputLength] = '\0';
+	core->expandedEnd = 0;
+	core->candidatesDismissed = false;
+	core->effects.dirty |= T3_DIRTY_INPUT;
+}
+
+const char * t3core_get_text(const T3Core * core) {
+	return core->inputString;
+}
+
+const char * t3core_get_key_text(const T3Core * core, uint8_t row, uint8_t col) {
+	if(core->set >= 3 || core->pickMode || row > core->rows || col > core->cols)
+		return NULL;
+	
+	if(core->selectionMode) {
+		// The selection view shows one character per button, on the center key
+		// of the first row that the button owns.
+		uint8_t button = _t3_rowButton(core, row);
+		if(col == (core->cols + 1) / 2 && row == _t3_firstRow(core, button))
+			return core->singleChars[button - 1];
+		else
+			return NULL;
+	} else
+		return _t3_getCharGroup(core, row, col);
+}
+
+bool t3core_is_key_pressed(const T3Core * core, uint8_t row, uint8_t col) {
+	// A row chosen in two-step mode shows all of its keys as pressed
+	return !core->selectionMode && !core->pickMode && row == core->row && col <= core->cols
+		&& (col == core->col || core->col == 0);
+}
+
+void t3core_set_entry_mode(T3Core * core, uint8_t mode) {
+	if(core->selectionMode)
+		_t3_toggleMode(core);
+	_t3_markKey(core, core->row, core->col);
+	core->row = 0;
+	core->col = 0;
+	core->timerPending = false;
+	core->entryMode = mode;
+}
+
+void t3core_set_mru(T3Core * core, struct T3Mru * mru) {
+	core->mru = mru;
+	_t3_learnSnippets(core);
+	_t3_updateCandidates(core);
+	core->effects.dirty |= T3_DIRTY_INPUT;
+}
+
+void t3core_set_snippets(T3Core * core, struct T3Snippets * snippets) {
+	core->snippets = snippets;
+	_t3_learnSnippets(core);
+}
+
+void t3core_set_words(T3Core * core, struct T3Words * words) {
+	core->words = words;
+	_t3_learnSnippets(core);
+	_t3_updateCandidates(core);
+	core->effects.dirty |= T3_DIRTY_INPUT;
+}
+
+void t3core_set_bigram(T3Core * core, struct T3Bigram * bigram) {
+	core->bigram = bigram;
+	_t3_updateCandidates(core);
+	core->effects.dirty |= T3_DIRTY_INPUT;
+}
+
+uint8_t t3core_get_candidate_count(const T3Core * core) {
+	return core->candidatesDismissed ? 0 : core->candidateCount;
+}
+
+const char * t3core_get_candidate(const T3Core * core, uint8_t index) {
+	return index < t3core_get_candidate_count(core) ? core->candidates[index].text : NULL;
+}
+
+bool t3core_is_picking(const T3Core * core) {
+	return core->pickMode;
+}
+
+size_t t3core_snapshot(const T3Core * core, uint32_t time, uint8_t * buffer, size_t size) {
+	if(size < T3_SNAPSHOT_MAX_BYTES || (core->inputLength == 0 && core->row == 0))
+		return 0;
+	
+	int32_t remaining = core->timerPending ? (int32_t)(core->deadline - time) : 0;
+	if(remaining < 0)
+		remaining = 0;
+	else if(remaining > _T3_MODE_TIMEOUT_IN_MS)
+		remaining = _T3_MODE_TIMEOUT_IN_MS;
+	
+	// Layout: version, set, kb, row, col, flags, remaining time (2 bytes),
+	// text length, text
+	buffer[0] = _T3_SNAPSHOT_VERSION;
+	buffer[1] = core->set;
+	buffer[2] = core->kb;
+	buffer[3] = core->row;
+	buffer[4] = core->col;
+	buffer[5] = (core->selectionMode ? _T3_SNAPSHOT_SELECTION : 0)
+			  | (core->timerPending ? _T3_SNAPSHOT_PENDING : 0);
+	buffer[6] = remaining & 0xFF;
+	buffer[7] = remaining >> 8;
+	buffer[8] = core->inputLength;
+	memcpy(&buffer[9], core->inputString, core->inputLength);
+	return 9 + core->inputLength;
+}
+
+bool t3core_restore(T3Core * core, uint32_t time, const uint8_t * buffer, size_t size) {
+	if(size < 9 || buffer[0] != _T3_SNAPSHOT_VERSION || buffer[8] > T3_MAXLENGTH
+		|| size != 9u + buffer[8] || buffer[1] >= 3 || buffer[2] >= core->keyboardCounts[buffer[1]])
+		return false;
+	
+	uint8_t set = core->set;
+	uint8_t kb = core->kb;
+	core->set = buffer[1];
+	core->kb = buffer[2];
+	if(!_t3_loadKeyboard(core) || buffer[3] > core->rows || buffer[4] > core->cols
+		|| (buffer[3] == 0 && buffer[4] != 0)
+		|| (buffer[3] != 0 && buffer[4] == 0 && (core->entryMode != T3_ENTRY_TWO_STEP || buffer[5] != 0))
+		|| ((buffer[5] & (_T3_SNAPSHOT_SELECTION | _T3_SNAPSHOT_PENDING)) != 0 && buffer[3] == 0)) {
+		core->set = set;
+		core->kb = kb;
+		_t3_loadKeyboard(core);
+		return false;
+	}
+	
+	core->row = buffer[3];
+	core->col = buffer[4];
+	core->pickMode = false;
+	core->selectionMode = false;
+	if(buffer[5] & _T3_SNAPSHOT_SELECTION)
+		_t3_toggleMode(core);
+	core->timerPending = (buffer[5] & _T3_SNAPSHOT_PENDING) != 0 && !core->selectionMode;
+	core->deadline = time + (buffer[6] | (buffer[7] << 8));
+	
+	char text[T3_MAXLENGTH + 1];
+	memcpy(text, &buffer[9], buffer[8]);
+	text[buffer[8]] = '\0';
+	t3core_set_text(core, text);
+	
+	core->effects.dirty |= T3_DIRTY_INPUT | T3_DIRTY_KEYS | T3_DIRTY_GRID;
+	return true;
+}
+
+void _t3_transition(T3Core * core, T3Event event) {
+	// Only updates the keyboard state and records what needs to be redrawn
+	// or rescheduled; the backend applies it once the queue is empty.
+	switch(event.type) {
+		case T3_EVENT_CLICK:
+			_t3_click(core, event.button, event.time);
+			break;
+		case T3_EVENT_LONGCLICK:
+			_t3_longclick(core, event.button - 1);
+			break;
+		case T3_EVENT_BACK:
+			_t3_back(core);
+			break;
+		case T3_EVENT_BACKSPACE:
+			_t3_backspace(core);
+			break;
+		case T3_EVENT_TIMEOUT:
+			_t3_timeout(core, event.time);
+			break;
+		case T3_EVENT_OPEN:
+			_t3_open(core);
+			break;
+	}
+}
+
+void _t3_back(T3Core * core) {
+	if(core->row != 0 && !core->selectionMode) {
+		// Cancel the pending key
+		_t3_markKey(core, core->row, core->col);
+		core->row = 0;
+		core->col = 0;
+		core->timerPending = false;
+	} else if(core->selectionMode)
+		_t3_toggleMode(core);
+	else if(!core->pickMode && _t3_currentCandidateCount(core) > 0) {
+		core->pickMode = true;
+		core->effects.dirty |= T3_DIRTY_INPUT | T3_DIRTY_KEYS;
+	} else {
+		// BACK in the picker accepts the text as it is, so that submitting
+		// never takes more than two presses
+		core->pickMode = false;
+		if(core->words != NULL)
+			t3words_learn(core->words, core->inputString);
+		if(core->mru != NULL) {
+			t3mru_add(core->mru, core->inputString);
+			_t3_learnSnippets(core);
+		}
+		_t3_updateCandidates(core);
+		core->effects.close = true;
+	}
+}
+
+void _t3_backspace(T3Core * core) {
+	if(core->pickMode) {
+		// Go back to the keys, keeping the candidates out of the way until
+		// the text changes
+		core->pickMode = false;
+		core->candidatesDismissed = true;
+		core->effects.dirty |= T3_DIRTY_INPUT | T3_DIRTY_KEYS;
+		return;
+	}
+	
+	if(core->expandedEnd != 0 && core->expandedEnd == core->inputLength) {
+		// Right after an expansion, put back what was typed
+		uint8_t length = strlen(core->expandedFrom);
+		memcpy(&core->inputString[core->expandedStart], core->expandedFrom, length + 1);
+		core->inputLength = core->expandedStart + length;
+		core->expandedEnd = 0;
+		core->candidatesDismissed = false;
+		core->effects.dirty |= T3_DIRTY_INPUT;
+		return;
+	}
+	
+	core->expandedEnd = 0;
+	if(core->inputLength > 0) {
+		// Remove continuation bytes until the lead byte of the last code point is gone
+		char removed;
+		do {
+			removed = core->inputString[--(core->inputLength)];
+			core->inputString[core->inputLength] = '\0';
+		} while(core->inputLength > 0 && (removed & 0xC0) == 0x80);
+		core->candidatesDismissed = false;
+		core->effects.dirty |= T3_DIRTY_INPUT;
+	}
+}
+
+void _t3_longclick(T3Core * core, uint8_t button) {
+	if(core->keyboardCounts[button] > 0) 	{
+		core->pickMode = false;
+		if(core->selectionMode)
+			_t3_toggleMode(core);
+		else if(core->row != 0) {
+			// A pending key or chosen row may not exist in the next keyboard
+			_t3_markKey(core, core->row, core->col);
+			core->row = 0;
+			core->col = 0;
+			core->timerPending = false;
+		}
+		
+		if(core->set == button) {
+			// Cycle the keyboard within the set
+			if(core->keyboardCounts[button] > 1)
+				if(++(core->kb) >= core->keyboardCounts[button])
+					core->kb = 0;
+		} else {
+			core->set = button;
+			core->kb = 0;
+		}
+		_t3_loadKeyboard(core);
+		core->effects.dirty |= T3_DIRTY_KEYS;
+	}
+}
+
+void _t3_click(T3Core * core, uint8_t button, uint32_t time) {
+	if(core->pickMode) {
+		_t3_pick(core, button - 1);
+		return;
+	} else if(core->set >= 3)
+		return;
+	
+	if(core->selectionMode) {
+		_t3_addChar(core, core->singleChars[button - 1]);
+		_t3_toggleMode(core);
+	} else if(core->entryMode == T3_ENTRY_TWO_STEP && core->rows == 3 && core->cols <= 3)
+		_t3_twoStepClick(core, button);
+	else {
+		// Each button owns a group of consecutive rows. Presses cycle through
+		// the columns of a row and then page on to the next row of the group.
+		uint8_t first = _t3_firstRow(core, button);
+		uint8_t last = _t3_firstRow(core, button + 1) - 1;
+		_t3_markKey(core, core->row, core->col);
+		if(core->row < first || core->row > last) {
+			core->row = first;
+			core->col = 1;
+		} else if(++(core->col) > core->cols) {
+			core->col = 1;
+			if(++(core->row) > last)
+				core->row = first;
+		}
+		_t3_markKey(core, core->row, core->col);
+		
+		// Every press pushes the deadline back; the backend's timer is only
+		// re-armed if it fires before the deadline.
+		core->timerPending = true;
+		core->deadline = time + _T3_MODE_TIMEOUT_IN_MS;
+	}
+}
+
+void _t3_twoStepClick(T3Core * core, uint8_t button) {
+	if(core->row == 0) {
+		core->row = button;
+		core->col = 0;
+		_t3_markKey(core, core->row, core->col);
+	} else if(button <= core->cols) {
+		_t3_markKey(core, core->row, core->col);
+		core->col = button;
+		const char * text = _t3_getCharGroup(core, core->row, core->col);
+		if(text[0] != '\0' && text[_t3_utf8CharLength(text)] != '\0')
+			_t3_toggleMode(core);
+		else {
+			// A key of one character needs no selection; an empty key does nothing
+			_t3_addChar(core, text);
+			core->row = 0;
+			core->col = 0;
+		}
+	}
+}
+
+void _t3_timeout(T3Core * core, uint32_t time) {
+	// A press that was cancelled, or pushed back by a later one, leaves nothing to do
+	if(!core->timerPending || (int32_t)(core->deadline - time) > 0)
+		return;
+	
+	core->timerPending = false;
+	const char * text = _t3_getCharGroup(core, core->row, core->col);
+	if(text[_t3_utf8CharLength(text)] == '\0') {
+		_t3_addChar(core, text);
+		_t3_markKey(core, core->row, core->col);
+		core->row = 0;
+		core->col = 0;
+	} else
+		_t3_toggleMode(core);
+}
+
+void _t3_open(T3Core * core) {
+	// Recent texts are offered right away when there is nothing to complete
+	core->candidatesDismissed = false;
+	_t3_updateCandidates(core);
+	if(core->inputLength == 0 && core->candidateCount > 0 && core->row == 0 && !core->selectionMode) {
+		core->pickMode = true;
+		core->effects.dirty |= T3_DIRTY_KEYS;
+	}
+	core->effects.dirty |= T3_DIRTY_INPUT;
+}
+
+void _t3_pick(T3Core * core, uint8_t index) {
+	if(index >= t3core_get_candidate_count(core))
+		return;
+	
+	const T3Candidate * candidate = &core->candidates[index];
+	core->inputLength -= candidate->replace;
+	uint8_t length = _t3_utf8Truncate(candidate->text, T3_MAXLENGTH - core->inputLength);
+	memcpy(&core->inputString[core->inputLength], candidate->text, length);
+	
+	if(length > candidate->replace)
+		_t3_countCommits(core, _t3_utf8Count(&candidate->text[candidate->replace], length - candidate->replace));
+	
+	core->inputLength += length;
+	core->inputString[core->inputLength] = '\0';
+	core->expandedEnd = 0;
+	core->pickMode = false;
+	core->effects.dirty |= T3_DIRTY_INPUT | T3_DIRTY_KEYS;
+}
+
+void _t3_updateCandidates(T3Core * core) {
+	core->candidateCount = 0;
+	if(core->mru != NULL)
+		core->candidateCount += t3mru_match(core->mru, core->inputString, core->inputLength,
+			&core->candidates[core->candidateCount], T3_MAX_CANDIDATES - core->candidateCount);
+	if(core->words != NULL)
+		core->candidateCount += t3words_complete(core->words, core->inputString, core->inputLength,
+			&core->candidates[core->candidateCount], T3_MAX_CANDIDATES - core->candidateCount);
+	if(core->bigram != NULL)
+		core->candidateCount += t3bigram_predict(core->bigram, core->inputString, core->inputLength,
+			&core->candidates[core->candidateCount], T3_MAX_CANDIDATES - core->candidateCount);
+	
+	if(core->candidateCount == 0 && core->pickMode) {
+		core->pickMode = false;
+		core->effects.dirty |= T3_DIRTY_KEYS;
+	}
+}
+
+uint8_t _t3_currentCandidateCount(T3Core * core) {
+	// The candidates are otherwise only looked up at the end of a batch, so
+	// they may still be those of a text that an earlier event changed
+	if(core->effects.dirty & T3_DIRTY_INPUT)
+		_t3_updateCandidates(core);
+	return t3core_get_candidate_count(core);
+}
+
+void _t3_expand(T3Core * core) {
+	// The abbreviation runs back from the trigger just added to the previous
+	// trigger or the start of the text, so the lookup is bounded by T3_MAXLENGTH.
+	uint8_t end = core->inputLength - 1;
+	uint8_t start = end;
+	while(start > 0 && strchr(T3_SNIPPET_TRIGGERS, core->inputString[start - 1]) == NULL)
+		--start;
+	if(start == end)
+		return;
+	
+	const char * expansion = t3snippets_find(core->snippets, &core->inputString[start], end - start);
+	if(expansion == NULL)
+		return;
+	
+	// An expansion that does not fit is left as typed rather than cut short
+	uint8_t length = strlen(expansion);
+	if(start + length + 1 > T3_MAXLENGTH)
+		return;
+	
+	uint8_t typed = _t3_utf8Count(&core->inputString[start], end - start);
+	uint8_t expanded = _t3_utf8Count(expansion, length);
+	if(expanded > typed)
+		_t3_countCommits(core, expanded - typed);
+	
+	// Keep what was typed, so that BACKSPACE can undo the expansion
+	memcpy(core->expandedFrom, &core->inputString[start], end + 1 - start);
+	core->expandedFrom[end + 1 - start] = '\0';
+	core->expandedStart = start;
+	
+	char trigger = core->inputString[end];
+	memcpy(&core->inputString[start], expansion, length);
+	core->inputString[start + length] = trigger;
+	core->inputLength = start + length + 1;
+	core->inputString[core->inputLength] = '\0';
+	core->expandedEnd = core->inputLength;
+}
+
+void _t3_learnSnippets(T3Core * core) {
+	if(core->snippets != NULL)
+		t3snippets_learn(core->snippets, core->mru, core->words);
+}
+
+void _t3_countCommits(T3Core * core, uint8_t count) {
+	core->effects.commits += count;
+	#if T3_COLLECT_STATS
+	core->stats.commits += count;
+	#endif
+}
+
+void _t3_toggleMode(T3Core * core) {
+	core->selectionMode = !core->selectionMode;
+	
+	if(core->selectionMode) {
+		const char * cg = _t3_getCharGroup(core, core->row, core->col);
+		for(uint8_t i = 0; i < _T3_MAX_CHARS_PER_KEY; ++i) {
+			uint8_t length = _t3_utf8CharLength(cg);
+			memcpy(core->singleChars[i], cg, length);
+			core->singleChars[i][length] = '\0';
+			cg += length;
+		}
+	} else {
+		core->row = 0;
+		core->col = 0;
+	}
+	
+	core->effects.dirty |= T3_DIRTY_KEYS;
+}
+
+bool _t3_addChar(T3Core * core, const char * c) {
+	uint8_t length = _t3_utf8CharLength(c);
+	if(core->inputLength + length <= T3_MAXLENGTH) {
+		if(length == 0)
+			return false;
+		else {
+			memcpy(&core->inputString[core->inputLength], c, length);
+			core->inputLength += length;
+			core->inputString[core->inputLength] = '\0';
+			core->expandedEnd = 0;
+			core->candidatesDismissed = false;
+			core->effects.dirty |= T3_DIRTY_INPUT;
+			++(core->effects.commits);
+			_T3_COUNT(core, commits);
+			
+			if(core->snippets != NULL && length == 1 && strchr(T3_SNIPPET_TRIGGERS, c[0]) != NULL)
+				_t3_expand(core);
+	
+			return true;
+		}
+	} else
+		return false;
+}
+
+bool _t3_loadKeyboard(T3Core * core) {
+	uint8_t rows = core->rows;
+	uint8_t cols = core->cols;
+	bool valid = core->set < 3;
+	const char * charset = valid ? core->keyboardSets[core->set][core->kb] : "";
+	
+	// An optional grid header of two non-printable bytes precedes the keys
+	uint16_t offset = 0;
+	if(charset[0] > '\0' && charset[0] < ' ') {
+		core->rows = charset[0];
+		core->cols = charset[1];
+		offset = 2;
+		if(core->rows < 3 || core->rows > T3_MAX_ROWS
+			|| core->cols < 1 || core->cols > T3_MAX_COLS) {
+			core->rows = 3;
+			core->cols = 3;
+			valid = false;
+		}
+	} else {
+		core->rows = 3;
+		core->cols = 3;
+	}
+	
+	if(core->rows != rows || core->cols != cols)
+		core->effects.dirty |= T3_DIRTY_GRID;
+	
+	if(core->set >= 3) {
+		core->keyboardValid = false;
+		return false;
+	}
+	
+	// Keys are packed back to back, so index the start of each one
+	// once per keyboard change rather than scanning on every lookup.
+	// An empty key ends the layout, so a layout with too few keys is never
+	// read past its end, and one with too many is caught after the last.
+	for(uint8_t i = 0; i < core->rows * core->cols && valid; ++i) {
+		core->keyOffsets[i] = offset;
+		uint8_t chars = 0;
+		while(charset[offset] != '\0') {
+			offset += _t3_utf8CharLength(&charset[offset]);
+			++chars;
+		}
+		if(chars == 0 || chars > _T3_MAX_CHARS_PER_KEY)
+			valid = false;
+		++offset;
+	}
+	if(valid && charset[offset] != '\0')
+		valid = false;
+	
+	core->keyboardValid = valid;
+	return valid;
+}
+
+const char * _t3_getCharGroup(const T3Core * core, int row, int col) {
+	// An invalid layout or key reads as empty rather than past the layout
+	if(core->set < 3 && (!core->keyboardValid || row < 1 || row > core->rows || col < 1 || col > core->cols))
+		return "";
+	else if(core->set < 3) {
+		const char * charset = core->keyboardSets[core->set][core->kb];
+		int index = ((row - 1) * core->cols) + (col - 1);
+		return &charset[core->keyOffsets[index]];
+	} else
+		return NULL;
+}
+
+void _t3_markKey(T3Core * core, uint8_t row, uint8_t col) {
+	// Column 0 stands for a whole row chosen in two-step mode
+	if(row != 0 && col == 0)
+		core->effects.dirtyKeys |= (((uint32_t)1 << core->cols) - 1) << ((row - 1) * T3_MAX_COLS);
+	else if(row != 0)
+		core->effects.dirtyKeys |= (uint32_t)1 << ((row - 1) * T3_MAX_COLS + (col - 1));
+}
+
+uint8_t _t3_firstRow(const T3Core * core, uint8_t button) {
+	// Rows are split into three consecutive groups, the last ones getting any extra
+	return (button - 1) * core->rows / 3 + 1;
+}
+
+uint8_t _t3_rowButton(const T3Core * core, uint8_t row) {
+	uint8_t button = 1;
+	while(button < 3 && row >= _t3_firstRow(core, button + 1))
+		++button;
+	return button;
+}
+
+uint8_t _t3_utf8CharLength(const char * c) {
+	uint8_t lead = (uint8_t)c[0];
+	uint8_t length;
+	if(lead == 0)
+		return 0;
+	else if(lead < 0x80)
+		return 1;
+	else if((lead & 0xE0) == 0xC0)
+		length = 2;
+	else if((lead & 0xF0) == 0xE0)
+		length = 3;
+	else if((lead & 0xF8) == 0xF0)
+		length = 4;
+	else
+		return 1;
+	
+	// Stop at a missing continuation byte so a malformed sequence
+	// can never run past its terminator.
+	for(uint8_t i = 1; i < length; ++i)
+		if(((uint8_t)c[i] & 0xC0) != 0x80)
+			return i;
+	return length;
+}
+
+uint8_t _t3_utf8Truncate(const char * text, uint8_t maxBytes) {
+	uint8_t length = 0;
+	while(text[length] != '\0') {
+		uint8_t charLength = _t3_utf8CharLength(&text[length]);
+		if(length + charLength > maxBytes)
+			break;
+		length += charLength;
+	}
+	return length;
+}
+
+uint8_t _t3_utf8Count(const char * text, uint8_t length) {
+	uint8_t count = 0;
+	for(uint8_t i = 0; i < length; ++i)
+		if((text[i] & 0xC0) != 0x80)
+			++count;
+	return count;
+}
@@ -0,0 +1,501 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#ifndef T3_CORE_H
+#define T3_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Whether to count wakeups, timer operations, redraws and committed
+ * characters so that the energy cost of text entry can be measured.
+ * Set to 1, or build with -DT3_COLLECT_STATS=1, to add the counters.
+ */
+#ifndef T3_COLLECT_STATS
+#define T3_COLLECT_STATS 0
+#endif
+
+/**
+ * Whether to build the pre-defined lower-case keyboard into the app.
+ * It is recommended you set this to 0 if you are not using it.
+ */
+#define T3_INCLUDE_LAYOUT_LOWERCASE 1
+	
+/**
+ * Whether to build the pre-defined upper-case keyboard into the app.
+ * It is recommended you set this to 0 if you are not using it.
+ */
+#define T3_INCLUDE_LAYOUT_UPPERCASE 1
+	
+/**
+ * Whether to build the pre-defined number keyboard into the app.
+ * It is recommended you set this to 0 if you are not using it.
+ */
+#define T3_INCLUDE_LAYOUT_NUMBERS 1
+	
+/**
+ * Whether to build the pre-defined punctuation keyboard into the app.
+ * It is recommended you set this to 0 if you are not using it.
+ */
+#define T3_INCLUDE_LAYOUT_PUNC 1
+	
+/**
+ * Whether to build the pre-defined bracket keyboard into the app.
+ * It is recommended you set this to 0 if you are not using it.
+ */
+#define T3_INCLUDE_LAYOUT_BRACKETS 1
+	
+/**
+ * Whether to build the pre-defined extended lower-case keyboard into the app.
+ * It is recommended you set this to 0 if you are not using it.
+ */
+#define T3_INCLUDE_LAYOUT_LOWERCASE_EXTENDED 1
+
+/**
+ * The largest number of key rows that a keyboard layout may declare.
+ * Every window reserves a key layer for each cell of the largest grid.
+ */
+#define T3_MAX_ROWS 4
+
+/**
+ * The largest number of key columns that a keyboard layout may declare.
+ */
+#define T3_MAX_COLS 4
+
+/**
+ * Grid headers that may be prepended to a keyboard layout to declare its
+ * number of rows and columns. A layout without a header is 3x3.
+ */
+#define T3_GRID_3X3 "\x03\x03"
+#define T3_GRID_3X4 "\x03\x04"
+#define T3_GRID_4X3 "\x04\x03"
+#define T3_GRID_4X4 "\x04\x04"
+
+/**
+ * A pre-defined keyboard with lower-case letters and a space:
+ *   abc  def  ghi
+ *   jkl  mno  pqr
+ *   stu  vwx  yz 
+ */
+#if T3_INCLUDE_LAYOUT_LOWERCASE
+extern const char T3_LAYOUT_LOWERCASE[];
+#endif
+
+/**
+ * A pre-defined keyboard with upper-case letters and a space:
+ *   ABC  DEF  GHI
+ *   JKL  MNO  PQR
+ *   STU  VWX  YZ 
+ */
+#if T3_INCLUDE_LAYOUT_UPPERCASE
+extern const char T3_LAYOUT_UPPERCASE[];
+#endif
+
+/**
+ * A pre-defined keyboard with numbers:
+ *   01   2    3
+ *   4    5    6
+ *   7    8    9
+ */
+#if T3_INCLUDE_LAYOUT_NUMBERS
+extern const char T3_LAYOUT_NUMBERS[];
+#endif
+
+/**
+ * A pre-defined keyboard with punctuation, operators, etc.:
+ *   .    '!   :;"
+ *   ,    -    @$#
+ *   ?    &%   +*=
+ */
+#if T3_INCLUDE_LAYOUT_PUNC
+extern const char T3_LAYOUT_PUNC[];
+#endif
+
+/**
+ * A pre-defined keyboard with brackets, slashes, and other
+ * miscellaneous characters:
+ *   ()   <>   {}
+ *   /    \    []
+ *   |_   ~^`  ¢½
+ */
+#if T3_INCLUDE_LAYOUT_BRACKETS
+extern const char T3_LAYOUT_BRACKETS[];
+#endif
+
+/**
+ * A pre-defined 4x3 keyboard with lower-case letters, a space and
+ * common punctuation:
+ *   abc  def  ghi
+ *   jkl  mno  pqr
+ *   stu  vwx  yz 
+ *   .,?  '!-  @:;
+ */
+#if T3_INCLUDE_LAYOUT_LOWERCASE_EXTENDED
+extern const char T3_LAYOUT_LOWERCASE_EXTENDED[];
+#endif
+
+/**
+ * The maximum number of bytes that the user may enter.
+ * Characters outside of ASCII take more than one byte in UTF-8.
+ */
+#define T3_MAXLENGTH 24
+
+/**
+ * The characters that separate words for completion and prediction.
+ */
+#define T3_WORD_SEPARATORS " .,?!;:\"()"
+
+#if T3_COLLECT_STATS
+/**
+ * Activity counters of a T3Window or T3Core, used to budget energy per message.
+ * Dividing by commits gives the cost of each entered character.
+ */
+typedef struct T3Stats {
+	uint32_t wakeups;   // Callbacks run by the backend: presses, timers
+	uint32_t timerOps;  // Timers registered, rescheduled or cancelled
+	uint32_t redraws;   // Layers redrawn by the window
+	uint32_t commits;   // Characters added to the input text
+} T3Stats;
+#endif
+
+/**
+ * The buttons that drive the keyboard, as used in T3Event.
+ */
+#define T3_BUTTON_UP 1
+#define T3_BUTTON_SELECT 2
+#define T3_BUTTON_DOWN 3
+
+/**
+ * The ways that a key and then a character are chosen, as set with
+ * t3core_set_entry_mode().
+ */
+typedef enum {
+	T3_ENTRY_MULTITAP,  // Presses cycle through the keys; a pause chooses one
+	T3_ENTRY_TWO_STEP   // One press chooses a row and another a key, with no pause
+} T3EntryMode;
+
+/**
+ * The types of input events that a T3Core handles.
+ */
+typedef enum {
+	T3_EVENT_CLICK,       // A short press of UP, SELECT or DOWN
+	T3_EVENT_LONGCLICK,   // A long press of UP, SELECT or DOWN
+	T3_EVENT_BACK,        // A single press of BACK
+	T3_EVENT_BACKSPACE,   // A double press of BACK
+	T3_EVENT_TIMEOUT,     // The deadline of a pending key may have passed
+	T3_EVENT_OPEN         // The keyboard was shown
+} T3EventType;
+
+/**
+ * Parts of the keyboard that need to be redrawn, as reported in T3Effects.
+ */
+#define T3_DIRTY_INPUT 0x01  // The input text
+#define T3_DIRTY_KEYS  0x02  // Every key
+#define T3_DIRTY_GRID  0x04  // The number of rows or columns, so keys must be laid out again
+
+/**
+ * The number of candidates offered at once, one per button.
+ */
+#define T3_MAX_CANDIDATES 3
+
+/**
+ * A text offered to the user to complete or replace the input.
+ */
+typedef struct T3Candidate {
+	const char * text;  // The text to insert
+	uint8_t replace;    // The number of bytes at the end of the input that it replaces
+} T3Candidate;
+
+/**
+ * The largest number of bytes written by t3core_snapshot().
+ */
+#define T3_SNAPSHOT_MAX_BYTES (9 + T3_MAXLENGTH)
+
+#define _T3_MAX_KEYS (T3_MAX_ROWS * T3_MAX_COLS)
+#define _T3_MAX_CHARS_PER_KEY 3
+#define _T3_MAX_CHAR_BYTES 4
+#define _T3_EVENT_QUEUE_SIZE 8
+
+#if _T3_MAX_KEYS > 32
+#error "T3_MAX_ROWS * T3_MAX_COLS must not exceed 32"
+#endif
+
+#if T3_COLLECT_STATS
+#define _T3_COUNT(core, counter) (++((core)->stats.counter))
+#else
+#define _T3_COUNT(core, counter)
+#endif
+
+/**
+ * An input event, stamped with the time in milliseconds at which it happened.
+ * The clock may start anywhere and wrap around; only differences are used.
+ */
+typedef struct T3Event {
+	uint8_t type;
+	uint8_t button;
+	uint32_t time;
+} T3Event;
+
+/**
+ * What a render backend has to do after the queued events were handled.
+ */
+typedef struct T3Effects {
+	uint8_t dirty;        // T3_DIRTY_* flags
+	uint32_t dirtyKeys;   // One bit per key at (row - 1) * T3_MAX_COLS + (col - 1)
+	uint8_t commits;      // Characters added to the input text
+	bool timerWanted;     // Whether a T3_EVENT_TIMEOUT must be posted at the deadline
+	uint32_t deadline;    // When the pending key times out
+	bool close;           // Whether the user accepted the text
+} T3Effects;
+
+/**
+ * The platform-independent state of a T3 keyboard.
+ *
+ * A backend posts input events to the core with t3core_post(), handles them
+ * with t3core_run() and then applies the returned T3Effects: it redraws the
+ * dirty parts, keeps a single timer armed while one is wanted, and closes
+ * the keyboard when asked to. The core never calls into the platform.
+ *
+ * The fields are private; use the t3core functions to access them.
+ */
+typedef struct T3Core {
+	const char ** keyboardSets[3];
+	uint8_t keyboardCounts[3];
+	uint8_t set;
+	uint8_t kb;
+	uint8_t row;
+	uint8_t col;
+	uint8_t rows;
+	uint8_t cols;
+	uint16_t keyOffsets[_T3_MAX_KEYS];
+	bool keyboardValid;
+	char singleChars[_T3_MAX_CHARS_PER_KEY][_T3_MAX_CHAR_BYTES + 1];
+	char inputString[T3_MAXLENGTH + 1];
+	uint8_t inputLength;
+	char expandedFrom[T3_MAXLENGTH + 1];  // The abbreviation and trigger of the last expansion
+	uint8_t expandedStart;
+	uint8_t expandedEnd;  // The input length right after the last expansion, or 0
+	uint8_t entryMode;
+	bool selectionMode;
+	bool pickMode;
+	bool timerPending;
+	uint32_t deadline;
+	T3Event events[_T3_EVENT_QUEUE_SIZE];
+	uint8_t eventHead;
+	uint8_t eventCount;
+	T3Effects effects;
+	struct T3Mru * mru;
+	struct T3Snippets * snippets;
+	struct T3Words * words;
+	struct T3Bigram * bigram;
+	T3Candidate candidates[T3_MAX_CANDIDATES];
+	uint8_t candidateCount;
+	bool candidatesDismissed;
+	#if T3_COLLECT_STATS
+	T3Stats stats;
+	#endif
+} T3Core;
+
+/**
+ * Initializes a T3Core with the given keyboard sets.
+ * See t3window_create() for a description of the sets and layouts.
+ *
+ * @param core  The T3Core to initialize.
+ * @param set1  The keyboard layouts selected with the UP button. May be null.
+ * @param count1  The number of keyboard layouts in set1.
+ * @param set2  The keyboard layouts selected with the SELECT button. May be null.
+ * @param count2  The number of keyboard layouts in set2.
+ * @param set3  The keyboard layouts selected with the DOWN button. May be null.
+ * @param count3  The number of keyboard layouts in set3.
+ * @return Whether a valid keyboard layout was found.
+ */
+bool t3core_init(T3Core * core,
+				 const char ** set1, uint8_t count1,
+				 const char ** set2, uint8_t count2,
+				 const char ** set3, uint8_t count3);
+
+/**
+ * Queues an input event. It is not handled until t3core_run() is called,
+ * so a burst of events may be queued and handled in a single pass.
+ *
+ * @param core  The T3Core to post to.
+ * @param type  The T3EventType of the event.
+ * @param button  The T3_BUTTON_* for clicks and long clicks, otherwise 0.
+ * @param time  The time of the event in milliseconds.
+ * @return Whether the event was queued. False if the queue is full, or if
+ *         a click or long click is not of a T3_BUTTON_*.
+ */
+bool t3core_post(T3Core * core, uint8_t type, uint8_t button, uint32_t time);
+
+/**
+ * Handles all queued events and reports what the backend needs to do.
+ *
+ * @param core  The T3Core whose events to handle.
+ * @param effects  The T3Effects to fill in, accumulated over all events.
+ */
+void t3core_run(T3Core * core, T3Effects * effects);
+
+/**
+ * Sets the input text. The change is reported by the next t3core_run().
+ *
+ * @param core  The T3Core whose text to set.
+ * @param text  The text to copy, up to T3_MAXLENGTH bytes without
+ *              splitting a character.
+ */
+void t3core_set_text(T3Core * core, const char * text);
+
+/**
+ * Gets the input text.
+ *
+ * @param core  The T3Core whose text to get.
+ * @return  A pointer to the input text.
+ */
+const char * t3core_get_text(const T3Core * core);
+
+/**
+ * Gets the text that a key should display.
+ *
+ * @param core  The T3Core whose key to get.
+ * @param row  The row of the key, starting at 1.
+ * @param col  The column of the key, starting at 1.
+ * @return  The text of the key, or null if the key should not be drawn.
+ */
+const char * t3core_get_key_text(const T3Core * core, uint8_t row, uint8_t col);
+
+/**
+ * Gets whether a key is shown as pressed.
+ *
+ * @param core  The T3Core whose key to check.
+ * @param row  The row of the key, starting at 1.
+ * @param col  The column of the key, starting at 1.
+ * @return  Whether the key is pending a commit.
+ */
+bool t3core_is_key_pressed(const T3Core * core, uint8_t row, uint8_t col);
+
+/**
+ * Sets how keys and characters are chosen. Any pending key is cancelled.
+ *
+ * In T3_ENTRY_TWO_STEP mode, UP, SELECT and DOWN first choose the top,
+ * middle or bottom row and then the left, center or right key of it. A key
+ * of one character commits it at once; otherwise the selection view opens
+ * and a third press chooses the character. No timer is used. Layouts that
+ * do not have three rows of at most three keys are entered by multi-tap.
+ *
+ * @param core  The T3Core whose mode to set.
+ * @param mode  The T3EntryMode to use.
+ */
+void t3core_set_entry_mode(T3Core * core, uint8_t mode);
+
+/**
+ * Attaches a list of recently entered texts. Its entries are offered as
+ * candidates, and the text is added to it when the keyboard closes.
+ * See T3Mru.h.
+ *
+ * @param core  The T3Core to attach the list to.
+ * @param mru  The T3Mru to use, or null to detach it.
+ */
+void t3core_set_mru(T3Core * core, struct T3Mru * mru);
+
+/**
+ * Attaches a set of snippets. When a trigger character such as a space is
+ * entered after one of their abbreviations, the abbreviation is replaced
+ * by its expansion if it fits. See T3Snippets.h.
+ *
+ * @param core  The T3Core to attach the snippets to.
+ * @param snippets  The T3Snippets to use, or null to detach them.
+ */
+void t3core_set_snippets(T3Core * core, struct T3Snippets * snippets);
+
+/**
+ * Attaches a table of word frequencies. Its best completions of the word
+ * being entered are offered as candidates after those of the recent texts,
+ * and the words of the text are counted when the keyboard closes.
+ * See T3Words.h.
+ *
+ * @param core  The T3Core to attach the table to.
+ * @param words  The T3Words to use, or null to detach it.
+ */
+void t3core_set_words(T3Core * core, struct T3Words * words);
+
+/**
+ * Attaches a table of likely next words. After a word and a separator are
+ * entered, the words most likely to follow it are offered as candidates
+ * after the others. See T3Bigram.h.
+ *
+ * @param core  The T3Core to attach the table to.
+ * @param bigram  The T3Bigram to use, or null to detach it.
+ */
+void t3core_set_bigram(T3Core * core, struct T3Bigram * bigram);
+
+/**
+ * Gets the number of candidates offered for the current input.
+ * Candidates are offered through BACK, or right away when the keyboard
+ * opens with no text, and are picked with UP, SELECT or DOWN. BACK then
+ * accepts the text, and BACKSPACE dismisses them.
+ *
+ * @param core  The T3Core whose candidates to count.
+ * @return  The number of candidates, or 0 if the user dismissed them.
+ */
+uint8_t t3core_get_candidate_count(const T3Core * core);
+
+/**
+ * Gets the text of a candidate.
+ *
+ * @param core  The T3Core whose candidate to get.
+ * @param index  The index of the candidate, starting at 0 for UP.
+ * @return  The text of the candidate, or null if there is none.
+ */
+const char * t3core_get_candidate(const T3Core * core, uint8_t index);
+
+/**
+ * Gets whether the candidates are shown in place of the keys.
+ *
+ * @param core  The T3Core to check.
+ * @return  Whether UP, SELECT and DOWN pick a candidate.
+ */
+bool t3core_is_picking(const T3Core * core);
+
+/**
+ * Writes the text and the keyboard state, including a pending key and the
+ * time left before it times out, to a compact, versioned blob.
+ *
+ * @param core  The T3Core to snapshot.
+ * @param time  The current time in milliseconds.
+ * @param buffer  The buffer to write to.
+ * @param size  The size of the buffer, at least T3_SNAPSHOT_MAX_BYTES.
+ * @return The number of bytes written, or 0 if there is no text or pending
+ *         key to resume or the buffer is too small.
+ */
+size_t t3core_snapshot(const T3Core * core, uint32_t time, uint8_t * buffer, size_t size);
+
+/**
+ * Restores a snapshot written by t3core_snapshot() for a T3Core with the
+ * same keyboard sets. A pending key times out after the time it had left.
+ * The change is reported by the next t3core_run().
+ *
+ * @param core  The T3Core to restore.
+ * @param time  The current time in milliseconds.
+ * @param buffer  The snapshot.
+ * @param size  The size of the snapshot in bytes.
+ * @return Whether the snapshot was valid. If not, the core is unchanged.
+ */
+bool t3core_restore(T3Core * core, uint32_t time, const uint8_t * buffer, size_t size);
+
+#endif
@@ -0,0 +1,126 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#include <string.h>
+#include "T3Mru.h"
+
+#define _T3_MRU_VERSION 1
+
+void t3mru_init(T3Mru * mru) {
+	mru->count = 0;
+	mru->changed = false;
+}
+
+void t3mru_add(T3Mru * mru, const char * text) {
+	if(text[0] == '\0')
+		return;
+	
+	uint8_t index = 0;
+	while(index < mru->count && strcmp(mru->entries[index], text) != 0)
+		++index;
+	if(index == 0 && mru->count > 0)
+		return;
+	
+	// Shift the newer entries down over the old copy, or over the oldest entry
+	if(index == mru->count) {
+		if(mru->count < T3_MRU_SIZE)
+			++(mru->count);
+		else
+			--index;
+	}
+	for(; index > 0; --index)
+		memcpy(mru->entries[index], mru->entries[index - 1], T3_MAXLENGTH + 1);
+	strncpy(mru->entries[0], text, T3_MAXLENGTH);
+	mru->entries[0][T3_MAXLENGTH] = '\0';
+	mru->changed = true;
+}
+
+uint8_t t3mru_match(const T3Mru * mru, const char * prefix, uint8_t length,
+					T3Candidate * candidates, uint8_t max) {
+	uint8_t found = 0;
+	for(uint8_t i = 0; i < mru->count && found < max; ++i) {
+		const char * entry = mru->entries[i];
+		if(strncmp(entry, prefix, length) == 0 && entry[length] != '\0') {
+			candidates[found].text = entry;
+			candidates[found].replace = length;
+			++found;
+		}
+	}
+	return found;
+}
+
+size_t t3mru_encode(T3Mru * mru, uint8_t * buffer, size_t size) {
+	if(size < 2)
+		return 0;
+	
+	// Layout: version, count, then for each entry the length of the prefix
+	// shared with the entry before it, the length of the rest, and the rest.
+	size_t used = 2;
+	uint8_t count = 0;
+	const char * previous = "";
+	for(; count < mru->count; ++count) {
+		const char * entry = mru->entries[count];
+		uint8_t shared = 0;
+		while(entry[shared] != '\0' && entry[shared] == previous[shared])
+			++shared;
+		uint8_t rest = strlen(entry) - shared;
+		if(used + 2 + rest > size)
+			break;
+		
+		buffer[used++] = shared;
+		buffer[used++] = rest;
+		memcpy(&buffer[used], &entry[shared], rest);
+		used += rest;
+		previous = entry;
+	}
+	buffer[0] = _T3_MRU_VERSION;
+	buffer[1] = count;
+	mru->changed = false;
+	return used;
+}
+
+bool t3mru_decode(T3Mru * mru, const uint8_t * buffer, size_t size) {
+	t3mru_init(mru);
+	if(size < 2 || buffer[0] != _T3_MRU_VERSION || buffer[1] > T3_MRU_SIZE)
+		return false;
+	
+	size_t used = 2;
+	uint8_t previousLength = 0;
+	for(uint8_t i = 0; i < buffer[1]; ++i) {
+		if(used + 2 > size)
+			break;
+		uint8_t shared = buffer[used++];
+		uint8_t rest = buffer[used++];
+		if(shared > previousLength || shared + rest > T3_MAXLENGTH || used + rest > size)
+			break;
+		
+		if(shared > 0)
+			memcpy(mru->entries[i], mru->entries[i - 1], shared);
+		memcpy(&mru->entries[i][shared], &buffer[used], rest);
+		mru->entries[i][shared + rest] = '\0';
+		used += rest;
+		previousLength = shared + rest;
+		++(mru->count);
+	}
+	
+	if(mru->count != buffer[1]) {
+		t3mru_init(mru);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#ifndef T3_MRU_H
+#define T3_MRU_H
+
+#include "T3Core.h"
+
+/**
+ * The number of recently entered texts to remember.
+ */
+#define T3_MRU_SIZE 5
+
+/**
+ * The largest number of bytes that the encoded list may take in persistent
+ * storage. Older entries that do not fit are dropped when it is saved.
+ */
+#define T3_MRU_MAX_BYTES 128
+
+/**
+ * A list of recently entered texts, most recent first.
+ *
+ * Texts are added when the keyboard closes and offered as candidates when
+ * it opens or when they start with the text being entered.
+ */
+typedef struct T3Mru {
+	char entries[T3_MRU_SIZE][T3_MAXLENGTH + 1];
+	uint8_t count;
+	bool changed;  // Whether the list changed since it was last encoded
+} T3Mru;
+
+/**
+ * Initializes an empty T3Mru.
+ *
+ * @param mru  The T3Mru to initialize.
+ */
+void t3mru_init(T3Mru * mru);
+
+/**
+ * Moves a text to the front of the list, dropping the oldest entry if full.
+ *
+ * @param mru  The T3Mru to add to.
+ * @param text  The text to add. Empty texts are ignored.
+ */
+void t3mru_add(T3Mru * mru, const char * text);
+
+/**
+ * Finds the entries that start with, but are longer than, a prefix.
+ *
+ * @param mru  The T3Mru to search.
+ * @param prefix  The text that the entries must start with.
+ * @param length  The length of the prefix in bytes.
+ * @param candidates  The array to fill with the matching entries.
+ * @param max  The size of the candidates array.
+ * @return The number of candidates found.
+ */
+uint8_t t3mru_match(const T3Mru * mru, const char * prefix, uint8_t length,
+					T3Candidate * candidates, uint8_t max);
+
+/**
+ * Encodes the list to a compact, versioned blob. Each entry only stores the
+ * bytes that differ from the entry before it. Clears the changed flag.
+ *
+ * @param mru  The T3Mru to encode.
+ * @param buffer  The buffer to write to.
+ * @param size  The size of the buffer. Entries that do not fit are dropped.
+ * @return The number of bytes written.
+ */
+size_t t3mru_encode(T3Mru * mru, uint8_t * buffer, size_t size);
+
+/**
+ * Decodes a blob written by t3mru_encode().
+ *
+ * @param mru  The T3Mru to fill.
+ * @param buffer  The encoded blob.
+ * @param size  The size of the blob in bytes.
+ * @return Whether the blob was valid. If not, the list is left empty.
+ */
+bool t3mru_decode(T3Mru * mru, const uint8_t * buffer, size_t size);
+
+#endif
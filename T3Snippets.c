@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#include <string.h>
+#include "T3Snippets.h"
+
+uint8_t _t3_snippetHash(const char * word, uint8_t length);
+uint8_t _t3_findBucket(const T3Snippets * snippets, const char * word, uint8_t length);
+const T3Snippet * _t3_getSnippet(const T3Snippets * snippets, uint8_t slot);
+void _t3_reindex(T3Snippets * snippets);
+
+void t3snippets_init(T3Snippets * snippets) {
+	snippets->count = 0;
+	snippets->learnedCount = 0;
+	snippets->learning = false;
+	memset(snippets->buckets, 0, sizeof(snippets->buckets));
+}
+
+bool t3snippets_add(T3Snippets * snippets, const char * abbreviation, const char * expansion) {
+	uint8_t length = strlen(abbreviation);
+	if(length == 0 || length > T3_MAXLENGTH)
+		return false;
+	
+	uint8_t bucket = _t3_findBucket(snippets, abbreviation, length);
+	uint8_t slot = snippets->buckets[bucket];
+	if(slot != 0 && slot <= snippets->count) {
+		snippets->snippets[slot - 1].expansion = expansion;
+		return true;
+	} else if(snippets->count >= T3_SNIPPET_CAPACITY)
+		return false;
+	
+	T3Snippet * snippet = &snippets->snippets[(snippets->count)++];
+	snippet->abbreviation = abbreviation;
+	snippet->expansion = expansion;
+	if(snippets->learnedCount == 0)
+		snippets->buckets[bucket] = snippets->count;
+	else
+		_t3_reindex(snippets);  // The learned snippets are numbered after this one
+	return true;
+}
+
+uint8_t t3snippets_add_packed(T3Snippets * snippets, char * packed, size_t size) {
+	uint8_t added = 0;
+	size_t i = 0;
+	while(i < size) {
+		// Terminate the abbreviation and the expansion in place. The last
+		// expansion may run to the end of the buffer. A CRLF line ending is
+		// one terminator, also once its carriage return became a null, so the
+		// same buffer parses alike when added again.
+		const char * parts[2];
+		for(uint8_t p = 0; p < 2; ++p) {
+			if(i >= size)
+				return added;
+			parts[p] = &packed[i];
+			while(i < size && packed[i] != '\0' && packed[i] != '\n' && packed[i] != '\r')
+				++i;
+			bool crlf = i + 1 < size && packed[i] != '\n' && packed[i + 1] == '\n';
+			packed[i++] = '\0';
+			if(crlf)
+				++i;
+		}
+		if(t3snippets_add(snippets, parts[0], parts[1]))
+			++added;
+	}
+	return added;
+}
+
+void t3snippets_set_learning(T3Snippets * snippets, bool learning) {
+	snippets->learning = learning;
+}
+
+void t3snippets_learn(T3Snippets * snippets, const T3Mru * mru, const T3Words * words) {
+	snippets->learnedCount = 0;
+	for(uint8_t i = 0; snippets->learning && mru != NULL && i < mru->count; ++i) {
+		// Take the first character of every word, if they are all ASCII
+		const char * entry = mru->entries[i];
+		char * abbreviation = snippets->learnedAbbreviations[snippets->learnedCount];
+		uint8_t length = 0;
+		bool valid = true;
+		for(uint8_t j = 0; entry[j] != '\0' && valid; ++j)
+			if(entry[j] != ' ' && (j == 0 || entry[j - 1] == ' ')) {
+				if((entry[j] & 0x80) != 0 || strchr(T3_SNIPPET_TRIGGERS, entry[j]) != NULL
+					|| length >= _T3_LEARNED_MAX_BYTES)
+					valid = false;
+				else
+					abbreviation[length++] = entry[j];
+			}
+		abbreviation[length] = '\0';
+		
+		if(valid && length >= 2 && (words == NULL || !t3words_contains(words, abbreviation, length))) {
+			snippets->learned[snippets->learnedCount].abbreviation = abbreviation;
+			snippets->learned[snippets->learnedCount].expansion = entry;
+			++(snippets->learnedCount);
+		}
+	}
+	_t3_reindex(snippets);
+}
+
+const char * t3snippets_find(const T3Snippets * snippets, const char * word, uint8_t length) {
+	const T3Snippet * snippet = _t3_getSnippet(snippets,
+		snippets->buckets[_t3_findBucket(snippets, word, length)]);
+	return snippet != NULL ? snippet->expansion : NULL;
+}
+
+uint8_t _t3_snippetHash(const char * word, uint8_t length) {
+	// FNV-1a, folded to the table size
+	uint32_t hash = 2166136261u;
+	for(uint8_t i = 0; i < length; ++i)
+		hash = (hash ^ (uint8_t)word[i]) * 16777619u;
+	return (hash ^ (hash >> 16)) % _T3_SNIPPET_BUCKETS;
+}
+
+uint8_t _t3_findBucket(const T3Snippets * snippets, const char * word, uint8_t length) {
+	// Linear probing; the table is never more than half full, so this
+	// stops at the matching or an empty bucket after a few steps.
+	uint8_t bucket = _t3_snippetHash(word, length);
+	for(;;) {
+		const T3Snippet * snippet = _t3_getSnippet(snippets, snippets->buckets[bucket]);
+		if(snippet == NULL || (strncmp(snippet->abbreviation, word, length) == 0
+			&& snippet->abbreviation[length] == '\0'))
+			return bucket;
+		bucket = (bucket + 1) % _T3_SNIPPET_BUCKETS;
+	}
+}
+
+const T3Snippet * _t3_getSnippet(const T3Snippets * snippets, uint8_t slot) {
+	if(slot == 0)
+		return NULL;
+	else if(slot <= snippets->count)
+		return &snippets->snippets[slot - 1];
+	else
+		return &snippets->learned[slot - 1 - snippets->count];
+}
+
+void _t3_reindex(T3Snippets * snippets) {
+	memset(snippets->buckets, 0, sizeof(snippets->buckets));
+	for(uint8_t slot = 1; slot <= snippets->count + snippets->learnedCount; ++slot) {
+		const T3Snippet * snippet = _t3_getSnippet(snippets, slot);
+		uint8_t bucket = _t3_findBucket(snippets, snippet->abbreviation, strlen(snippet->abbreviation));
+		if(snippets->buckets[bucket] == 0)
+			snippets->buckets[bucket] = slot;
+	}
+}
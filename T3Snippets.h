@@ -0,0 +1,135 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#ifndef T3_SNIPPETS_H
+#define T3_SNIPPETS_H
+
+#include "T3Core.h"
+#include "T3Mru.h"
+#include "T3Words.h"
+
+/**
+ * The largest number of snippets that may be registered or loaded.
+ */
+#define T3_SNIPPET_CAPACITY 32
+
+/**
+ * The characters that expand the abbreviation typed before them.
+ */
+#define T3_SNIPPET_TRIGGERS " .,?!"
+
+#define _T3_SNIPPET_BUCKETS 128
+#define _T3_LEARNED_MAX_BYTES 8
+
+#if _T3_SNIPPET_BUCKETS < 2 * (T3_SNIPPET_CAPACITY + T3_MRU_SIZE)
+#error "_T3_SNIPPET_BUCKETS must be at least twice the number of snippets"
+#endif
+
+/**
+ * An abbreviation and the text that it expands to.
+ */
+typedef struct T3Snippet {
+	const char * abbreviation;
+	const char * expansion;
+} T3Snippet;
+
+/**
+ * A set of snippets, indexed by a hash of their abbreviations so that a
+ * lookup costs the same however many snippets there are.
+ *
+ * Besides the registered snippets, the set may learn the initials of recent
+ * texts of several words, so "on my way" may be typed as "omw". This is off
+ * unless enabled with t3snippets_set_learning(), since a learned
+ * abbreviation may be typed as a word of its own.
+ */
+typedef struct T3Snippets {
+	T3Snippet snippets[T3_SNIPPET_CAPACITY];
+	uint8_t count;
+	T3Snippet learned[T3_MRU_SIZE];
+	char learnedAbbreviations[T3_MRU_SIZE][_T3_LEARNED_MAX_BYTES + 1];
+	uint8_t learnedCount;
+	bool learning;   // Whether the initials of recent texts are learned
+	uint8_t buckets[_T3_SNIPPET_BUCKETS];  // 1-based index into snippets, then learned
+} T3Snippets;
+
+/**
+ * Initializes an empty T3Snippets.
+ *
+ * @param snippets  The T3Snippets to initialize.
+ */
+void t3snippets_init(T3Snippets * snippets);
+
+/**
+ * Registers a snippet, replacing any with the same abbreviation.
+ *
+ * @param snippets  The T3Snippets to add to.
+ * @param abbreviation  The abbreviation. It must not contain a trigger.
+ * @param expansion  The text to replace it with.
+ *                   Both strings are not copied and must outlive the set.
+ * @return Whether the snippet was added. False if the set is full.
+ */
+bool t3snippets_add(T3Snippets * snippets, const char * abbreviation, const char * expansion);
+
+/**
+ * Registers the snippets packed in a buffer, such as a loaded resource.
+ * The buffer holds an abbreviation and its expansion for each snippet,
+ * each terminated by a null, a newline or a CRLF line ending, or by the end
+ * of the buffer for the last expansion. Line endings are replaced by nulls.
+ *
+ * @param snippets  The T3Snippets to add to.
+ * @param packed  The packed snippets. It must outlive the set and have room
+ *                for a null at packed[size], written if the last expansion
+ *                runs to the end.
+ * @param size  The size of the snippets in bytes.
+ * @return The number of snippets added.
+ */
+uint8_t t3snippets_add_packed(T3Snippets * snippets, char * packed, size_t size);
+
+/**
+ * Sets whether t3snippets_learn() learns the initials of recent texts.
+ * Takes effect on the next call to t3snippets_learn().
+ *
+ * @param snippets  The T3Snippets to set.
+ * @param learning  Whether to learn. Off by default.
+ */
+void t3snippets_set_learning(T3Snippets * snippets, bool learning);
+
+/**
+ * Replaces the learned snippets with the initials of the recent texts
+ * that have two or more words, if learning is enabled. Registered snippets
+ * take precedence. Initials that spell a known word are not learned, so
+ * that the word can still be typed.
+ *
+ * @param snippets  The T3Snippets to update.
+ * @param mru  The recent texts to learn from, or null to forget them.
+ * @param words  The learned words and dictionary to check the initials
+ *               against, or null for none.
+ */
+void t3snippets_learn(T3Snippets * snippets, const T3Mru * mru, const T3Words * words);
+
+/**
+ * Finds the expansion of an abbreviation.
+ *
+ * @param snippets  The T3Snippets to search.
+ * @param word  The abbreviation to look up. It need not be terminated.
+ * @param length  The length of the word in bytes.
+ * @return The expansion, or null if there is none.
+ */
+const char * t3snippets_find(const T3Snippets * snippets, const char * word, uint8_t length);
+
+#endif
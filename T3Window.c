@@ -17,67 +17,44 @@
  ******************************************************************************/
 
 #include "T3Window.h"
+#include "T3Mru.h"
+#include "T3Snippets.h"
+#include "T3Words.h"
+#include "T3Bigram.h"
 
-#if T3_INCLUDE_LAYOUT_LOWERCASE
-const char T3_LAYOUT_LOWERCASE[] =
-	"abc\0"  "def\0"  "ghi\0"
-	"jkl\0"  "mno\0"  "pqr\0"
-	"stu\0"  "vwx\0"  "yz ";
-#endif
-
-#if T3_INCLUDE_LAYOUT_UPPERCASE
-const char T3_LAYOUT_UPPERCASE[] =
-	"ABC\0"  "DEF\0"  "GHI\0"
-	"JKL\0"  "MNO\0"  "PQR\0"
-	"STU\0"  "VWX\0"  "YZ ";
-#endif
-
-#if T3_INCLUDE_LAYOUT_NUMBERS
-const char T3_LAYOUT_NUMBERS[] =
-	"\x30\x31\0\0"  "\x32\0\0\0"  "\x33\0\0\0"
-	"\x34\0\0\0"    "\x35\0\0\0"  "\x36\0\0\0"
-	"\x37\0\0\0"    "\x38\0\0\0"  "\x39\0\0";
-#endif
-
-#if T3_INCLUDE_LAYOUT_PUNC
-const char T3_LAYOUT_PUNC[] =
-	".\0\0\0"  "'!\0\0"   ":;\"\0"
-	",\0\0\0"  "-\0\0\0"  "@$#\0"
-	"?\0\0\0"  "&%\0\0"   "+*=";
-#endif
-
-#if T3_INCLUDE_LAYOUT_BRACKETS
-const char T3_LAYOUT_BRACKETS[] =
-	"()\0\0"   "<>\0\0"    "{}\0\0"
-	"/\0\0\0"  "\\\0\0\0"  "[]\0\0"
-	"|_\0\0"   "~^`\0"     "¢½\0";
-#endif
-	
-#define _T3_KEYBOARD_SIZE 9 * 4
 #define _T3_X_OFFSET 7
 #define _T3_Y_OFFSET 74
-#define _T3_X_SPACING 45
-#define _T3_Y_SPACING 31
-#define _T3_BUTTON_WIDTH 40
-#define _T3_BUTTON_HEIGHT 26
-#define _T3_MODE_TIMEOUT_IN_MS 600
+#define _T3_BOTTOM_MARGIN 6
+#define _T3_KEY_GAP 5
+
+typedef struct _t3_SnippetResource {
+	struct _t3_SnippetResource * next;
+	char data[];
+} _t3_SnippetResource;
 
 typedef struct _t3_T3Window {
 	Window * window;
-	const char ** keyboardSets[3];
-	uint8_t keyboardCounts[3];
 	T3CloseHandler closeHandler;
-	uint8_t set;
-	uint8_t kb;
-	uint8_t row;
-	uint8_t col;
-	char singleChars[3][2];
-	Layer * buttons[9];
+	T3Core core;
+	GRect keyArea;
+	Layer * buttons[_T3_MAX_KEYS];
 	Layer * inputLayer;
-	char inputString[T3_MAXLENGTH + 1];
-	uint8_t inputLength;
-	bool selectionMode;
+	Layer * pickLayer;
 	AppTimer * timer;
+	T3Mru * mru;
+	uint32_t mruKey;
+	T3Snippets * snippets;
+	_t3_SnippetResource * snippetResources;
+	T3Words * words;
+	bool wordsEnabled;
+	uint32_t wordsKey;
+	T3Bigram * bigram;
+	bool resumeEnabled;
+	uint32_t resumeKey;
+	bool closing;
+	uint8_t resumeSize;
+	uint8_t resumeBlob[T3_SNAPSHOT_MAX_BYTES];
+	bool dispatching;
 	#if PBL_COLOR
 	GColor background;
 	GColor keyFace;
@@ -105,8 +82,9 @@ typedef struct _t3_KeyData {
 	uint8_t col;
 } _t3_KeyData;
 
-bool _t3_validateKeyboard(const char * keyboard);
 void _t3_clickConfigProvider(void * context);
+void _t3_appear(Window * window);
+void _t3_disappear(Window * window);
 void _t3_back_click(ClickRecognizerRef recognizer, void * context);
 void _t3_backspace_click(ClickRecognizerRef recognizer, void * context);
 void _t3_r1_longclick(ClickRecognizerRef recognizer, void * context);
@@ -115,14 +93,19 @@ void _t3_r3_longclick(ClickRecognizerRef recognizer, void * context);
 void _t3_r1_click(ClickRecognizerRef recognizer, void * context);
 void _t3_r2_click(ClickRecognizerRef recognizer, void * context);
 void _t3_r3_click(ClickRecognizerRef recognizer, void * context);
-void _t3_longclick(T3Window * window, uint8_t button);
-void _t3_click(T3Window * window, uint8_t row);
+void _t3_postEvent(T3Window * window, uint8_t type, uint8_t button);
+void _t3_dispatch(T3Window * window);
 void _t3_timerCallback(void * context);
+uint32_t _t3_now(void);
 void _t3_drawInput(Layer * layer, GContext * ctx);
 void _t3_drawKey(Layer * layer, GContext * ctx);
-void _t3_toggleMode(T3Window * window);
-bool _t3_addChar(T3Window * window, char c);
-const char * _t3_getCharGroup(const T3Window * window, int row, int col);
+void _t3_drawPicks(Layer * layer, GContext * ctx);
+void _t3_drawKeyFace(T3Window * window, GContext * ctx, GRect bounds, bool isPressed);
+void _t3_saveMru(T3Window * window);
+T3Snippets * _t3_getSnippets(T3Window * window);
+T3Words * _t3_getWords(T3Window * window);
+void _t3_saveWords(T3Window * window);
+void _t3_layoutKeys(T3Window * window);
 
 T3Window * t3window_create(const char ** set1, uint8_t count1,
 						 const char ** set2, uint8_t count2,
@@ -130,36 +113,27 @@ T3Window * t3window_create(const char ** set1, uint8_t count1,
 						 T3CloseHandler closeHandler) {
 	T3Window * w = (T3Window*)malloc(sizeof(T3Window));
 	
-	if(set1 != NULL && count1 > 0)
-		w->set = 0;
-	else if(set2 != NULL && count2 > 0)
-		w->set = 1;
-	else if(set3 != NULL && count3 > 0)
-		w->set = 2;
-	else {
-		w->set = 3;
-		
+	if(!t3core_init(&w->core, set1, count1, set2, count2, set3, count3)) {
 		#if T3_LOGGING
-		app_log(APP_LOG_LEVEL_ERROR, "T3Window.c", 141, "No T3 keyboards defined!");
+		APP_LOG(APP_LOG_LEVEL_ERROR, "No valid T3 keyboards defined!");
 		#endif
 	}
 	
-	w->kb = 0;
-	w->row = 0;
-	w->col = 0;
-	w->selectionMode = false;
 	w->timer = NULL;
-	
-	w->keyboardSets[0] = set1;
-	w->keyboardSets[1] = set2;
-	w->keyboardSets[2] = set3;
-	w->keyboardCounts[0] = count1;
-	w->keyboardCounts[1] = count2;
-	w->keyboardCounts[2] = count3;
+	w->mru = NULL;
+	w->snippets = NULL;
+	w->snippetResources = NULL;
+	w->words = NULL;
+	w->wordsEnabled = false;
+	w->bigram = NULL;
+	w->resumeEnabled = false;
+	w->closing = false;
+	w->resumeSize = 0;
+	w->dispatching = false;
 	w->closeHandler = closeHandler;
 
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 160, "Initializing T3 window");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Initializing T3 window");
 	#endif
 	
 	w->window = window_create();
@@ -171,27 +145,32 @@ T3Window * t3window_create(const char ** set1, uint8_t count1,
 	#endif
 	window_set_click_config_provider_with_context(w->window,
 		(ClickConfigProvider)_t3_clickConfigProvider, w);
+	window_set_user_data(w->window, w);
+	window_set_window_handlers(w->window, (WindowHandlers) {
+		.appear = _t3_appear,
+		.disappear = _t3_disappear
+	});
 
 	Layer * windowLayer = window_get_root_layer(w->window);
+	GRect bounds = layer_get_bounds(windowLayer);
 	
 	// Create input label
-	w->inputLayer = layer_create_with_data(GRect(4, 4, 136, 64), sizeof(_t3_InputData));
+	w->inputLayer = layer_create_with_data(GRect(4, 4, bounds.size.w - 8, 64), sizeof(_t3_InputData));
 	_t3_InputData * data = layer_get_data(w->inputLayer);
 	data->t3window = w;
 	layer_set_update_proc(w->inputLayer, _t3_drawInput);
 	layer_add_child(windowLayer, w->inputLayer);
 	
-	// Create button layers
-	for(int8_t r = 0; r < 3; ++r) {
-		for(int8_t c = 0; c < 3; ++c) {
-			uint8_t index = r * 3 + c;
-			Layer * layer = layer_create_with_data(
-				GRect(
-					_T3_X_OFFSET + c * _T3_X_SPACING,
-					_T3_Y_OFFSET + r * _T3_Y_SPACING,
-					_T3_BUTTON_WIDTH,
-					_T3_BUTTON_HEIGHT),
-				sizeof(_t3_KeyData));
+	// Create button layers; they are positioned for the active grid by _t3_layoutKeys()
+	w->keyArea = GRect(
+		_T3_X_OFFSET,
+		_T3_Y_OFFSET,
+		bounds.size.w - 2 * _T3_X_OFFSET,
+		bounds.size.h - _T3_Y_OFFSET - _T3_BOTTOM_MARGIN);
+	for(int8_t r = 0; r < T3_MAX_ROWS; ++r) {
+		for(int8_t c = 0; c < T3_MAX_COLS; ++c) {
+			uint8_t index = r * T3_MAX_COLS + c;
+			Layer * layer = layer_create_with_data(GRect(0, 0, 0, 0), sizeof(_t3_KeyData));
 			_t3_KeyData * data = layer_get_data(layer);
 			data->t3window = w;
 			data->row = r + 1;
@@ -202,22 +181,22 @@ T3Window * t3window_create(const char ** set1, uint8_t count1,
 			w->buttons[index] = layer;
 		}
 	}
+	_t3_layoutKeys(w);
+	
+	// Create the candidate picker over the keys; it is only shown while picking
+	w->pickLayer = layer_create_with_data(w->keyArea, sizeof(_t3_InputData));
+	data = layer_get_data(w->pickLayer);
+	data->t3window = w;
+	layer_set_update_proc(w->pickLayer, _t3_drawPicks);
+	layer_set_hidden(w->pickLayer, true);
+	layer_add_child(windowLayer, w->pickLayer);
 	
 	#if PBL_COLOR
 	T3_SET_THEME_GRAY(w);
 	#endif
 	
-	w->singleChars[0][1] = '\0';
-	w->singleChars[1][1] = '\0';
-	w->singleChars[2][1] = '\0';
-	
-	// Initialize input
-	for(uint8_t i = 0; i <= T3_MAXLENGTH; ++i)
-		w->inputString[i] = '\0';
-	w->inputLength = 0;
-	
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 228, "T3 window initialized");
+	APP_LOG(APP_LOG_LEVEL_INFO, "T3 window initialized");
 	#endif
 	
 	return w;
@@ -230,7 +209,7 @@ void t3window_set_colors(T3Window * window, GColor background,
 						 GColor editBackground, GColor editText,
 						 GColor editHighlight, GColor editShadow) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 241, "Setting T3 window colors");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Setting T3 window colors");
 	#endif
 		
 	window->background = background;
@@ -252,7 +231,7 @@ void t3window_set_pressed_key_colors(T3Window * window,
 									GColor keyFace, GColor keyText,
 									GColor keyHighlight, GColor keyShadow) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 263, "Setting T3 window pressed key colors");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Setting T3 window pressed key colors");
 	#endif
 		
 	window->pressedKeyFace = keyFace;
@@ -264,19 +243,35 @@ void t3window_set_pressed_key_colors(T3Window * window,
 
 void t3window_destroy(T3Window * window) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 275, "Destroying T3 window");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Destroying T3 window");
 	#endif
 	
+	if(window->timer != NULL)
+		app_timer_cancel(window->timer);
 	layer_destroy(window->inputLayer);
-	for(int8_t i = 0; i < 9; ++i)
+	layer_destroy(window->pickLayer);
+	for(int8_t i = 0; i < _T3_MAX_KEYS; ++i)
 		layer_destroy(window->buttons[i]);
 	window_destroy(window->window);
+	if(window->mru != NULL)
+		free(window->mru);
+	if(window->snippets != NULL)
+		free(window->snippets);
+	if(window->words != NULL)
+		free(window->words);
+	if(window->bigram != NULL)
+		free(window->bigram);
+	while(window->snippetResources != NULL) {
+		_t3_SnippetResource * next = window->snippetResources->next;
+		free(window->snippetResources);
+		window->snippetResources = next;
+	}
 	free(window);
 }
 
 void t3window_show(const T3Window * window, bool animated) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 288, "Showing T3 window");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Showing T3 window");
 	#endif
 	
 	window_stack_push(window->window, animated);
@@ -284,21 +279,186 @@ void t3window_show(const T3Window * window, bool animated) {
 
 void t3window_set_text(T3Window * window, const char * text) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 296, "Setting T3 window text: %s", text);
+	APP_LOG(APP_LOG_LEVEL_INFO, "Setting T3 window text: %s", text);
 	#endif
 	
-	window->inputLength = strlen(text);
-	if(window->inputLength > 0)
-		strncpy(window->inputString, text, T3_MAXLENGTH);
-	layer_mark_dirty(window->inputLayer);
+	t3core_set_text(&window->core, text);
+	if(!window->dispatching)
+		_t3_dispatch(window);
 }
 
+void t3window_set_entry_mode(T3Window * window, T3EntryMode mode) {
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Setting T3 entry mode %d", mode);
+	#endif
+	
+	t3core_set_entry_mode(&window->core, mode);
+	if(!window->dispatching)
+		_t3_dispatch(window);
+}
+
+void t3window_enable_mru(T3Window * window, uint32_t persistKey) {
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Enabling recent texts under key %d", (int)persistKey);
+	#endif
+	
+	if(window->mru == NULL)
+		window->mru = (T3Mru*)malloc(sizeof(T3Mru));
+	window->mruKey = persistKey;
+	
+	uint8_t buffer[T3_MRU_MAX_BYTES];
+	int size = persist_exists(persistKey) ? persist_read_data(persistKey, buffer, sizeof(buffer)) : 0;
+	if(size <= 0 || !t3mru_decode(window->mru, buffer, size)) {
+		#if T3_LOGGING
+		APP_LOG(APP_LOG_LEVEL_INFO, "No recent texts stored");
+		#endif
+		
+		t3mru_init(window->mru);
+	}
+	
+	t3core_set_mru(&window->core, window->mru);
+	if(!window->dispatching)
+		_t3_dispatch(window);
+}
+
+void t3window_enable_words(T3Window * window, uint32_t persistKey) {
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Enabling learned words under key %d", (int)persistKey);
+	#endif
+	
+	T3Words * words = _t3_getWords(window);
+	window->wordsEnabled = true;
+	window->wordsKey = persistKey;
+	
+	uint8_t buffer[T3_WORDS_MAX_BYTES];
+	int size = persist_exists(persistKey) ? persist_read_data(persistKey, buffer, sizeof(buffer)) : 0;
+	if(size > 0)
+		t3words_decode(words, buffer, size);
+	
+	t3core_set_words(&window->core, words);
+	if(!window->dispatching)
+		_t3_dispatch(window);
+}
+
+void t3window_set_dictionary(T3Window * window, const char * dictionary) {
+	t3words_set_dictionary(_t3_getWords(window), dictionary);
+	t3core_set_words(&window->core, window->words);
+	if(!window->dispatching)
+		_t3_dispatch(window);
+}
+
+bool t3window_load_bigram(T3Window * window, uint32_t resourceId) {
+	ResHandle handle = resource_get_handle(resourceId);
+	size_t size = resource_size(handle);
+	
+	// The table is read in place, so it is loaded right after the T3Bigram
+	T3Bigram * bigram = (T3Bigram*)malloc(sizeof(T3Bigram) + size);
+	if(bigram == NULL)
+		return false;
+	uint8_t * data = (uint8_t*)(bigram + 1);
+	resource_load(handle, data, size);
+	if(!t3bigram_init(bigram, data, size)) {
+		#if T3_LOGGING
+		APP_LOG(APP_LOG_LEVEL_ERROR, "Invalid next word table");
+		#endif
+		
+		free(bigram);
+		return false;
+	}
+	
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Loaded %d next word entries from %d bytes", bigram->entryCount, (int)size);
+	#endif
+	
+	t3core_set_bigram(&window->core, bigram);
+	if(window->bigram != NULL)
+		free(window->bigram);
+	window->bigram = bigram;
+	if(!window->dispatching)
+		_t3_dispatch(window);
+	return true;
+}
+
+bool t3window_enable_resume(T3Window * window, uint32_t persistKey) {
+	window->resumeEnabled = true;
+	window->resumeKey = persistKey;
+	window->resumeSize = 0;
+	
+	int size = persist_exists(persistKey)
+		? persist_read_data(persistKey, window->resumeBlob, sizeof(window->resumeBlob)) : 0;
+	if(size <= 0 || !t3core_restore(&window->core, _t3_now(), window->resumeBlob, size)) {
+		#if T3_LOGGING
+		APP_LOG(APP_LOG_LEVEL_INFO, "No T3 window state to resume");
+		#endif
+		
+		return false;
+	}
+	
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Resuming T3 window state of %d bytes", size);
+	#endif
+	
+	// Lays out the restored keyboard and arms the timer of a pending key
+	window->resumeSize = size;
+	if(!window->dispatching)
+		_t3_dispatch(window);
+	return true;
+}
+
+bool t3window_add_snippet(T3Window * window, const char * abbreviation, const char * expansion) {
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Adding snippet %s", abbreviation);
+	#endif
+	
+	return t3snippets_add(_t3_getSnippets(window), abbreviation, expansion);
+}
+
+uint8_t t3window_load_snippets(T3Window * window, uint32_t resourceId) {
+	ResHandle handle = resource_get_handle(resourceId);
+	size_t size = resource_size(handle);
+	
+	// The snippets point into the loaded data, so it is kept until destroyed.
+	// One more byte ends a last expansion that has no newline.
+	_t3_SnippetResource * resource = (_t3_SnippetResource*)malloc(sizeof(_t3_SnippetResource) + size + 1);
+	if(resource == NULL)
+		return 0;
+	resource_load(handle, (uint8_t*)resource->data, size);
+	resource->next = window->snippetResources;
+	window->snippetResources = resource;
+	
+	uint8_t added = t3snippets_add_packed(_t3_getSnippets(window), resource->data, size);
+	
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Loaded %d snippets from %d bytes", added, (int)size);
+	#endif
+	
+	return added;
+}
+
+void t3window_enable_learned_snippets(T3Window * window) {
+	t3snippets_set_learning(_t3_getSnippets(window), true);
+	t3core_set_snippets(&window->core, window->snippets);
+}
+
+#if T3_COLLECT_STATS
+void t3window_get_stats(const T3Window * window, T3Stats * stats) {
+	*stats = window->core.stats;
+}
+
+void t3window_reset_stats(T3Window * window) {
+	window->core.stats.wakeups = 0;
+	window->core.stats.timerOps = 0;
+	window->core.stats.redraws = 0;
+	window->core.stats.commits = 0;
+}
+#endif
+
 const char * t3window_get_text(const T3Window * window) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 308, "Getting T3 window text");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Getting T3 window text");
 	#endif
 	
-	return window->inputString;
+	return t3core_get_text(&window->core);
 }
 
 void _t3_clickConfigProvider(void * context) {
@@ -320,159 +480,181 @@ void _t3_clickConfigProvider(void * context) {
 		(ClickHandler)_t3_r3_click);
 }
 
+void _t3_appear(Window * window) {
+	T3Window * w = (T3Window*)window_get_user_data(window);
+	w->closing = false;
+	_t3_postEvent(w, T3_EVENT_OPEN, 0);
+}
+
+void _t3_disappear(Window * window) {
+	T3Window * w = (T3Window*)window_get_user_data(window);
+	if(!w->resumeEnabled)
+		return;
+	
+	// Accepted text is not resumed. Otherwise the state is only written if
+	// it changed since it was last read or written.
+	uint8_t blob[T3_SNAPSHOT_MAX_BYTES];
+	size_t size = w->closing ? 0 : t3core_snapshot(&w->core, _t3_now(), blob, sizeof(blob));
+	if(size == 0) {
+		if(w->resumeSize > 0)
+			persist_delete(w->resumeKey);
+	} else if(size != w->resumeSize || memcmp(blob, w->resumeBlob, size) != 0) {
+		#if T3_LOGGING
+		APP_LOG(APP_LOG_LEVEL_INFO, "Saving %d bytes of T3 window state", (int)size);
+		#endif
+		
+		persist_write_data(w->resumeKey, blob, size);
+		memcpy(w->resumeBlob, blob, size);
+	}
+	w->resumeSize = size;
+}
+
 void _t3_backspace_click(ClickRecognizerRef recognizer, void * context) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 335, "Backspace");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Backspace");
 	#endif
 	
-	T3Window * w = (T3Window*)context;
-	if(w->inputLength > 0) {
-		w->inputString[--(w->inputLength)] = '\0';
-		layer_mark_dirty(w->inputLayer);
-	}
+	_t3_postEvent((T3Window*)context, T3_EVENT_BACKSPACE, 0);
 }
 
 void _t3_back_click(ClickRecognizerRef recognizer, void * context) {
 	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 347, "Back clicked");
+	APP_LOG(APP_LOG_LEVEL_INFO, "Back clicked");
 	#endif
-		
-	T3Window * w = (T3Window*)context;
-	if(w->timer != NULL) {
-		#if T3_LOGGING
-		app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 353, "Cancelling timer");
-		#endif
-
-		app_timer_cancel(w->timer);
-		w->row = 0;
-		w->col = 0;
-		// **************************************************** may need to refresh
-	} else if(w->selectionMode) {
-		#if T3_LOGGING
-		app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 362, "Cancelling char selection");
-		#endif
-		
-		_t3_toggleMode(w);
-	} else {
-		#if T3_LOGGING
-		app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 368, "Popping window");
-		#endif
-		
-		window_stack_pop(true);
-		if(w->closeHandler != NULL)
-			w->closeHandler(w->inputString);
-	}
+	
+	_t3_postEvent((T3Window*)context, T3_EVENT_BACK, 0);
 }
 
 void _t3_r1_longclick(ClickRecognizerRef recognizer, void * context) {
-	_t3_longclick((T3Window*)context, 0);
+	_t3_postEvent((T3Window*)context, T3_EVENT_LONGCLICK, T3_BUTTON_UP);
 }
 
 void _t3_r2_longclick(ClickRecognizerRef recognizer, void * context) {
-	_t3_longclick((T3Window*)context, 1);
+	_t3_postEvent((T3Window*)context, T3_EVENT_LONGCLICK, T3_BUTTON_SELECT);
 }
 
 void _t3_r3_longclick(ClickRecognizerRef recognizer, void * context) {
-	_t3_longclick((T3Window*)context, 2);
+	_t3_postEvent((T3Window*)context, T3_EVENT_LONGCLICK, T3_BUTTON_DOWN);
 }
 
 void _t3_r1_click(ClickRecognizerRef recognizer, void * context) {
-	_t3_click((T3Window*)context, 1);
+	_t3_postEvent((T3Window*)context, T3_EVENT_CLICK, T3_BUTTON_UP);
 }
 
 void _t3_r2_click(ClickRecognizerRef recognizer, void * context) {
-	_t3_click((T3Window*)context, 2);
+	_t3_postEvent((T3Window*)context, T3_EVENT_CLICK, T3_BUTTON_SELECT);
 }
 
 void _t3_r3_click(ClickRecognizerRef recognizer, void * context) {
-	_t3_click((T3Window*)context, 3);
+	_t3_postEvent((T3Window*)context, T3_EVENT_CLICK, T3_BUTTON_DOWN);
 }
 
-void _t3_longclick(T3Window * window, uint8_t button) {
-	if(window->keyboardCounts[button] > 0) 	{
-		if(window->selectionMode)
-			_t3_toggleMode(window);
-		
-		if(window->set == button) {
-			if(window->keyboardCounts[button] > 1) {
-				#if T3_LOGGING
-				app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 409, "Cycling keyboard");
-				#endif
-				
-				if(++(window->kb) >= window->keyboardCounts[button])
-					window->kb = 0;
-			}
-		} else {
-			#if T3_LOGGING
-			app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 417, "Changing keyboard set");
-			#endif
-			
-			window->set = button;
-			window->kb = 0;
-		}
-		layer_mark_dirty(window_get_root_layer(window->window));
+void _t3_timerCallback(void * context) {
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Timer timeout");
+	#endif
+	
+	T3Window * w = (T3Window*)context;
+	w->timer = NULL;
+	_t3_postEvent(w, T3_EVENT_TIMEOUT, 0);
+}
+
+uint32_t _t3_now(void) {
+	time_t seconds;
+	uint16_t milliseconds;
+	time_ms(&seconds, &milliseconds);
+	// Wraps around, which is fine since only differences are compared
+	return (uint32_t)seconds * 1000 + milliseconds;
+}
+
+void _t3_postEvent(T3Window * window, uint8_t type, uint8_t button) {
+	_T3_COUNT(&window->core, wakeups);
+	if(!t3core_post(&window->core, type, button, _t3_now())) {
+		#if T3_LOGGING
+		APP_LOG(APP_LOG_LEVEL_ERROR, "Event queue full, dropping event");
+		#endif
 	}
+	
+	// Each click is a turn of the event loop of its own, so the queue is run
+	// right away. The layers it marks dirty are drawn once, on the next
+	// frame. Events posted while the queue is draining are picked up by the
+	// running dispatch.
+	if(!window->dispatching)
+		_t3_dispatch(window);
 }
 
-void _t3_click(T3Window * window, uint8_t row) {
-	if(window->selectionMode) {
-		_t3_addChar(window, window->singleChars[row - 1][0]);
-		_t3_toggleMode(window);
-	} else {
-		if(window->row != row) {
+void _t3_dispatch(T3Window * window) {
+	window->dispatching = true;
+	bool closed = false;
+	T3Effects effects;
+	do {
+		t3core_run(&window->core, &effects);
+		
+		if(effects.dirty & T3_DIRTY_GRID)
+			_t3_layoutKeys(window);
+		if(effects.dirty & (T3_DIRTY_KEYS | T3_DIRTY_GRID)) {
+			layer_set_hidden(window->pickLayer, !t3core_is_picking(&window->core));
+			layer_mark_dirty(window_get_root_layer(window->window));
+		} else {
+			// Only the keys whose highlight changed need to be redrawn
+			if(effects.dirty & T3_DIRTY_INPUT)
+				layer_mark_dirty(window->inputLayer);
+			for(uint8_t i = 0; i < _T3_MAX_KEYS; ++i)
+				if(effects.dirtyKeys & ((uint32_t)1 << i))
+					layer_mark_dirty(window->buttons[i]);
+		}
+		
+		// The deadline moves with every press, but a running timer is left
+		// alone. If it fires too early, the core keeps the key pending and
+		// the timer is armed again for the rest of the deadline.
+		if(effects.timerWanted && window->timer == NULL) {
+			int32_t remaining = (int32_t)(effects.deadline - _t3_now());
+			
 			#if T3_LOGGING
-			app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 434, "Changing row");
+			APP_LOG(APP_LOG_LEVEL_INFO, "Starting timer for %d ms", (int)remaining);
 			#endif
 			
-			window->row = row;
-			window->col = 1;
-			layer_mark_dirty(window_get_root_layer(window->window));
-		} else {
+			window->timer = app_timer_register(remaining > 0 ? remaining : 0, _t3_timerCallback, window);
+			_T3_COUNT(&window->core, timerOps);
+		} else if(!effects.timerWanted && window->timer != NULL) {
 			#if T3_LOGGING
-			app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 442, "Cycling column");
+			APP_LOG(APP_LOG_LEVEL_INFO, "Cancelling timer");
 			#endif
 			
-			if(++(window->col) > 3)
-				window->col = 1;
-			layer_mark_dirty(window_get_root_layer(window->window));
+			app_timer_cancel(window->timer);
+			window->timer = NULL;
+			_T3_COUNT(&window->core, timerOps);
 		}
 		
-		if(window->timer == NULL) {
+		if(effects.close) {
 			#if T3_LOGGING
-			app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 452, "Starting timer");
+			APP_LOG(APP_LOG_LEVEL_INFO, "Popping window");
 			#endif
 			
-			window->timer = app_timer_register(_T3_MODE_TIMEOUT_IN_MS, _t3_timerCallback, window);
-		} else {
-			#if T3_LOGGING
-			app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 458, "Rescheduling timer");
-			#endif
+			window->closing = true;
+			
+			// Flash is only written here, and only if the list changed
+			if(window->mru != NULL && window->mru->changed)
+				_t3_saveMru(window);
+			if(window->wordsEnabled && window->words->changed)
+				_t3_saveWords(window);
 			
-			app_timer_reschedule(window->timer, _T3_MODE_TIMEOUT_IN_MS);
+			window_stack_pop(true);
+			closed = true;
+			break;
 		}
-	}
-}
-
-void _t3_timerCallback(void * context) {
-	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 468, "Timer timeout");
-	#endif
+	} while(window->core.eventCount > 0);
+	window->dispatching = false;
 	
-	T3Window * w = (T3Window*)context;
-	const char * text = _t3_getCharGroup(w, w->row, w->col);
-	if(text[1] == '\0') {
-		_t3_addChar(w, text[0]);
-		w->row = 0;
-		w->col = 0;
-	} else
-		_t3_toggleMode(w);
-	w->timer = NULL;
-	layer_mark_dirty(window_get_root_layer(w->window));
+	// The handler may destroy the window, so it is never touched afterwards
+	if(closed && window->closeHandler != NULL)
+		window->closeHandler(t3core_get_text(&window->core));
 }
 
 void _t3_drawInput(Layer * layer, GContext * context) {
 	GRect bounds = layer_get_bounds(layer);
 	_t3_InputData * data = layer_get_data(layer);
+	_T3_COUNT(&data->t3window->core, redraws);
 	
 	#if PBL_BW
 	graphics_context_set_stroke_color(context, GColorBlack);
@@ -502,121 +684,170 @@ void _t3_drawInput(Layer * layer, GContext * context) {
 	bounds.origin.y += 2;
 	bounds.size.w -= 4;
 	bounds.size.h -= 4;
-	graphics_draw_text(context, data->t3window->inputString, fonts_get_system_font(FONT_KEY_GOTHIC_24),
+	graphics_draw_text(context, t3core_get_text(&data->t3window->core), fonts_get_system_font(FONT_KEY_GOTHIC_24),
 		bounds, GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
+	
+	// Hint at the best candidate, which BACK offers for picking
+	const char * candidate = t3core_get_candidate(&data->t3window->core, 0);
+	if(candidate != NULL && !t3core_is_picking(&data->t3window->core)) {
+		bounds.origin.y += bounds.size.h - 16;
+		bounds.size.h = 16;
+		graphics_draw_text(context, candidate, fonts_get_system_font(FONT_KEY_GOTHIC_14),
+			bounds, GTextOverflowModeTrailingEllipsis, GTextAlignmentRight, NULL);
+	}
 }
 
 void _t3_drawKey(Layer * layer, GContext * context) {
 	GRect bounds = layer_get_bounds(layer);
 	_t3_KeyData * data = layer_get_data(layer);
+	_T3_COUNT(&data->t3window->core, redraws);
 	
-	if(!data->t3window->selectionMode || data->col == 2) {
-		const char * text;
-		if(data->t3window->selectionMode) {
-			text = data->t3window->singleChars[data->row - 1];
-			if(text == NULL)
-				return;
-		} else
-			text = _t3_getCharGroup(data->t3window, data->row, data->col);
-
-		bool isPressed = !data->t3window->selectionMode
-			&& data->row == data->t3window->row
-			&& data->col == data->t3window->col;
-
-		#if PBL_BW
-		if(isPressed) {
-			graphics_context_set_stroke_color(context, GColorBlack);
-			graphics_draw_rect(context, bounds);
-			graphics_context_set_text_color(context, GColorBlack);
-		} else {
-			graphics_context_set_fill_color(context, GColorBlack);
-			graphics_fill_rect(context, bounds, 0, GCornerNone);
-			graphics_context_set_text_color(context, GColorWhite);
-		}
-		#endif
-
-		#if PBL_COLOR
-		uint8_t h = _T3_BUTTON_HEIGHT - 1;
-		uint8_t w = _T3_BUTTON_WIDTH - 1;
-		if(isPressed) {
-			// Face
-			graphics_context_set_fill_color(context, data->t3window->pressedKeyFace);
-			graphics_fill_rect(context, bounds, 0, GCornerNone);
-			// Shadow
-			graphics_context_set_stroke_color(context, data->t3window->pressedKeyShadow);
-			graphics_draw_line(context, bounds.origin, GPoint(w, 0));
-			graphics_draw_line(context, bounds.origin, GPoint(0, h));
-			// Highlight
-			graphics_context_set_stroke_color(context, data->t3window->pressedKeyHighlight);
-			graphics_draw_line(context, GPoint(1, h), GPoint(w, h));
-			graphics_draw_line(context, GPoint(w, 1), GPoint(w, h));
-			// Text
-			graphics_context_set_text_color(context, data->t3window->pressedKeyText);
-		} else {
-			// Face
-			graphics_context_set_fill_color(context, data->t3window->keyFace);
-			graphics_fill_rect(context, bounds, 0, GCornerNone);
-			// Highlight
-			graphics_context_set_stroke_color(context, data->t3window->keyHighlight);
-			graphics_draw_line(context, bounds.origin, GPoint(w, 0));
-			graphics_draw_line(context, bounds.origin, GPoint(0, w));
-			// Shadow
-			graphics_context_set_stroke_color(context, data->t3window->keyShadow);
-			graphics_draw_line(context, GPoint(1, h), GPoint(w, h));
-			graphics_draw_line(context, GPoint(w, 1), GPoint(w, h));
-			// Text
-			graphics_context_set_text_color(context, data->t3window->keyText);
-		}
-		#endif
-
+	const char * text = t3core_get_key_text(&data->t3window->core, data->row, data->col);
+	if(text != NULL) {
+		bool isPressed = t3core_is_key_pressed(&data->t3window->core, data->row, data->col);
+		_t3_drawKeyFace(data->t3window, context, bounds, isPressed);
 		graphics_draw_text(context, text, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
 			bounds, GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
 	}
 }
 
-void _t3_toggleMode(T3Window * window) {
-	#if T3_LOGGING
-	app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 587, "Toggling mode");
-	#endif
+void _t3_drawPicks(Layer * layer, GContext * context) {
+	GRect bounds = layer_get_bounds(layer);
+	_t3_InputData * data = layer_get_data(layer);
+	_T3_COUNT(&data->t3window->core, redraws);
 	
-	window->selectionMode = !window->selectionMode;
+	#if PBL_BW
+	graphics_context_set_fill_color(context, GColorWhite);
+	#endif
+	#if PBL_COLOR
+	graphics_context_set_fill_color(context, data->t3window->background);
+	#endif
+	graphics_fill_rect(context, bounds, 0, GCornerNone);
 	
-	if(window->selectionMode) {
-		const char * cg = _t3_getCharGroup(window, window->row, window->col);
-		window->singleChars[0][0] = cg[0];
-		window->singleChars[1][0] = cg[1];
-		window->singleChars[2][0] = cg[2];
+	// One full-width key per button, top to bottom
+	int16_t ySpacing = (bounds.size.h + _T3_KEY_GAP) / T3_MAX_CANDIDATES;
+	for(uint8_t i = 0; i < T3_MAX_CANDIDATES; ++i) {
+		const char * text = t3core_get_candidate(&data->t3window->core, i);
+		if(text == NULL)
+			continue;
+		
+		GRect key = GRect(0, i * ySpacing, bounds.size.w, ySpacing - _T3_KEY_GAP);
+		_t3_drawKeyFace(data->t3window, context, key, false);
+		key.origin.x += 4;
+		key.size.w -= 8;
+		graphics_draw_text(context, text, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD),
+			key, GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+	}
+}
+
+void _t3_drawKeyFace(T3Window * window, GContext * context, GRect bounds, bool isPressed) {
+	#if PBL_BW
+	if(isPressed) {
+		graphics_context_set_stroke_color(context, GColorBlack);
+		graphics_draw_rect(context, bounds);
+		graphics_context_set_text_color(context, GColorBlack);
+	} else {
+		graphics_context_set_fill_color(context, GColorBlack);
+		graphics_fill_rect(context, bounds, 0, GCornerNone);
+		graphics_context_set_text_color(context, GColorWhite);
+	}
+	#endif
+
+	#if PBL_COLOR
+	GPoint topLeft = bounds.origin;
+	GPoint topRight = GPoint(bounds.origin.x + bounds.size.w - 1, bounds.origin.y);
+	GPoint bottomLeft = GPoint(bounds.origin.x, bounds.origin.y + bounds.size.h - 1);
+	GPoint bottomRight = GPoint(topRight.x, bottomLeft.y);
+	if(isPressed) {
+		// Face
+		graphics_context_set_fill_color(context, window->pressedKeyFace);
+		graphics_fill_rect(context, bounds, 0, GCornerNone);
+		// Shadow
+		graphics_context_set_stroke_color(context, window->pressedKeyShadow);
+		graphics_draw_line(context, topLeft, topRight);
+		graphics_draw_line(context, topLeft, bottomLeft);
+		// Highlight
+		graphics_context_set_stroke_color(context, window->pressedKeyHighlight);
+		graphics_draw_line(context, GPoint(topLeft.x + 1, bottomLeft.y), bottomRight);
+		graphics_draw_line(context, GPoint(topRight.x, topLeft.y + 1), bottomRight);
+		// Text
+		graphics_context_set_text_color(context, window->pressedKeyText);
 	} else {
-		window->row = 0;
-		window->col = 0;
+		// Face
+		graphics_context_set_fill_color(context, window->keyFace);
+		graphics_fill_rect(context, bounds, 0, GCornerNone);
+		// Highlight
+		graphics_context_set_stroke_color(context, window->keyHighlight);
+		graphics_draw_line(context, topLeft, topRight);
+		graphics_draw_line(context, topLeft, bottomLeft);
+		// Shadow
+		graphics_context_set_stroke_color(context, window->keyShadow);
+		graphics_draw_line(context, GPoint(topLeft.x + 1, bottomLeft.y), bottomRight);
+		graphics_draw_line(context, GPoint(topRight.x, topLeft.y + 1), bottomRight);
+		// Text
+		graphics_context_set_text_color(context, window->keyText);
 	}
+	#endif
+}
+
+void _t3_saveMru(T3Window * window) {
+	uint8_t buffer[T3_MRU_MAX_BYTES];
+	size_t size = t3mru_encode(window->mru, buffer, sizeof(buffer));
 	
-	layer_mark_dirty(window_get_root_layer(window->window));
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Saving %d bytes of recent texts", (int)size);
+	#endif
+	
+	persist_write_data(window->mruKey, buffer, size);
 }
 
-bool _t3_addChar(T3Window * window, char c) {
-	if(window->inputLength < T3_MAXLENGTH) {
-		if(c == '\0')
-			return false;
-		else {
-			#if T3_LOGGING
-			app_log(APP_LOG_LEVEL_INFO, "T3Window.c", 611, "Adding char: %c", c);
-			#endif
+T3Snippets * _t3_getSnippets(T3Window * window) {
+	if(window->snippets == NULL) {
+		window->snippets = (T3Snippets*)malloc(sizeof(T3Snippets));
+		t3snippets_init(window->snippets);
+		t3core_set_snippets(&window->core, window->snippets);
+	}
+	return window->snippets;
+}
 
-			window->inputString[(window->inputLength)++] = c;
-			layer_mark_dirty(window->inputLayer);
+T3Words * _t3_getWords(T3Window * window) {
+	if(window->words == NULL) {
+		window->words = (T3Words*)malloc(sizeof(T3Words));
+		t3words_init(window->words);
+	}
+	return window->words;
+}
+
+void _t3_saveWords(T3Window * window) {
+	uint8_t buffer[T3_WORDS_MAX_BYTES];
+	size_t size = t3words_encode(window->words, buffer, sizeof(buffer));
 	
-			return true;
-		}
-	} else
-		return false;
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Saving %d bytes of learned words", (int)size);
+	#endif
+	
+	persist_write_data(window->wordsKey, buffer, size);
 }
 
-const char * _t3_getCharGroup(const T3Window * window, int row, int col) {
-	if(window->set < 3) {
-		const char * charset = window->keyboardSets[window->set][window->kb];
-		int index = ((row - 1) * 3) + (col - 1);
-		return &charset[index * 4];
-	} else
-		return NULL;
+void _t3_layoutKeys(T3Window * window) {
+	#if T3_LOGGING
+	APP_LOG(APP_LOG_LEVEL_INFO, "Laying out %dx%d grid", window->core.rows, window->core.cols);
+	#endif
+	
+	int16_t xSpacing = (window->keyArea.size.w + _T3_KEY_GAP) / window->core.cols;
+	int16_t ySpacing = (window->keyArea.size.h + _T3_KEY_GAP) / window->core.rows;
+	for(int8_t r = 0; r < T3_MAX_ROWS; ++r) {
+		for(int8_t c = 0; c < T3_MAX_COLS; ++c) {
+			Layer * layer = window->buttons[r * T3_MAX_COLS + c];
+			if(r < window->core.rows && c < window->core.cols) {
+				layer_set_frame(layer, GRect(
+					window->keyArea.origin.x + c * xSpacing,
+					window->keyArea.origin.y + r * ySpacing,
+					xSpacing - _T3_KEY_GAP,
+					ySpacing - _T3_KEY_GAP));
+				layer_set_hidden(layer, false);
+			} else
+				layer_set_hidden(layer, true);
+		}
+	}
 }
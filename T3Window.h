@@ -20,93 +20,13 @@
 #define T3_WINDOW_H
 
 #include <pebble.h>
+#include "T3Core.h"
 
 /**
  * Whether diagnostic information of keyboard events should be logged.
  */
 #define T3_LOGGING 0
 
-/**
- * Whether to build the pre-defined lower-case keyboard into the app.
- * It is recommended you set this to 0 if you are not using it.
- */
-#define T3_INCLUDE_LAYOUT_LOWERCASE 1
-	
-/**
- * Whether to build the pre-defined upper-case keyboard into the app.
- * It is recommended you set this to 0 if you are not using it.
- */
-#define T3_INCLUDE_LAYOUT_UPPERCASE 1
-	
-/**
- * Whether to build the pre-defined number keyboard into the app.
- * It is recommended you set this to 0 if you are not using it.
- */
-#define T3_INCLUDE_LAYOUT_NUMBERS 1
-	
-/**
- * Whether to build the pre-defined punctuation keyboard into the app.
- * It is recommended you set this to 0 if you are not using it.
- */
-#define T3_INCLUDE_LAYOUT_PUNC 1
-	
-/**
- * Whether to build the pre-defined bracket keyboard into the app.
- * It is recommended you set this to 0 if you are not using it.
- */
-#define T3_INCLUDE_LAYOUT_BRACKETS 1
-
-/**
- * A pre-defined keyboard with lower-case letters and a space:
- *   abc  def  ghi
- *   jkl  mno  pqr
- *   stu  vwx  yz 
- */
-#if T3_INCLUDE_LAYOUT_LOWERCASE
-extern const char T3_LAYOUT_LOWERCASE[];
-#endif
-
-/**
- * A pre-defined keyboard with upper-case letters and a space:
- *   ABC  DEF  GHI
- *   JKL  MNO  PQR
- *   STU  VWX  YZ 
- */
-#if T3_INCLUDE_LAYOUT_UPPERCASE
-extern const char T3_LAYOUT_UPPERCASE[];
-#endif
-
-/**
- * A pre-defined keyboard with numbers:
- *   01   2    3
- *   4    5    6
- *   7    8    9
- */
-#if T3_INCLUDE_LAYOUT_NUMBERS
-extern const char T3_LAYOUT_NUMBERS[];
-#endif
-
-/**
- * A pre-defined keyboard with punctuation, operators, etc.:
- *   .    '!   :;"
- *   ,    -    @$#
- *   ?    &%   +*=
- */
-#if T3_INCLUDE_LAYOUT_PUNC
-extern const char T3_LAYOUT_PUNC[];
-#endif
-
-/**
- * A pre-defined keyboard with brackets, slashes, and other
- * miscellaneous characters:
- *   ()   <>   {}
- *   /    \    []
- *   |_   ~^`  ¢½
- */
-#if T3_INCLUDE_LAYOUT_BRACKETS
-extern const char T3_LAYOUT_BRACKETS[];
-#endif
-
 #if PBL_COLOR
 /**
   * Sets a pre-defined gray color theme to the window.
@@ -126,11 +46,6 @@ extern const char T3_LAYOUT_BRACKETS[];
 #define T3_SET_THEME_GREEN(t3window) t3window_set_colors(t3window, GColorDarkGreen, GColorMayGreen, GColorBlack, GColorMintGreen, GColorBlack, GColorWhite, GColorBlack, GColorMintGreen, GColorBlack)
 #endif
 
-/**
- * The maximum number of characters that the user may enter.
- */
-#define T3_MAXLENGTH 24
-
 /**
  * The T3Window type.
  *
@@ -172,18 +87,26 @@ typedef void (*T3CloseHandler)(const char * text);
  *      return myT3Window;
  *   }
  *
- * A keyboard layout is defined by a 36-character string: Nine key definitions,
- * each key consisting of four characters.  A key may start with up to three
- * printable characters and the rest is filled with null terminators.  Keys are
- * defined in the order of: top-left, top-center, top-right, middle-left,
- * middle-center, middle-right, bottom-left, bottom-center, bottom-right.
+ * A keyboard layout is defined by a UTF-8 string of packed key definitions,
+ * optionally preceded by a grid header.  Each key holds one to three printable
+ * characters, which may be multi-byte, followed by a null terminator.  The
+ * layout is ended by an empty key, which is the string's own terminator.
+ * Keys are defined row by row, from top-left to bottom-right.  A layout whose
+ * number of keys does not match its grid is rejected.
+ *
+ * Without a header, a layout has nine keys in three rows and three columns.
+ * A header is two bytes giving the number of rows (3 to T3_MAX_ROWS) and
+ * columns (1 to T3_MAX_COLS), such as T3_GRID_4X3.  The rows are split into
+ * three groups that are assigned to the UP, SELECT and DOWN buttons, with the
+ * lower groups getting any extra rows.  Repeated presses of a button cycle
+ * through the keys of a row and then page on to the next row of its group.
  *
- *    layout := key key key key key key key key key
- *    key := null null null null
- *         | char null null null
- *         | char char null null
+ *    layout := grid? key* null
+ *    grid := rows cols
+ *    key := char null
+ *         | char char null
  *         | char char char null
- *    char := (any printable character)
+ *    char := (any printable UTF-8 character)
  *    null := \0
  *
  * @param set1  A pointer to an array of strings containing the keyboard layouts
@@ -275,11 +198,162 @@ void t3window_show(const T3Window * window, bool animated);
  *
  * @param window  The T3Window whose text to set.
  * @param text  A pointer to the text to display.
- *              This will be copied locally, up to the T3_MAXLENGTH,
- *              so a stack-allocated string may be used.
+ *              This will be copied locally, up to the T3_MAXLENGTH
+ *              bytes without splitting a character, so a stack-allocated
+ *              string may be used.
  */
 void t3window_set_text(T3Window * window, const char * text);
 
+/**
+ * Sets how keys and characters are chosen. By default, T3_ENTRY_MULTITAP
+ * cycles through the keys of a row with repeated presses and chooses one
+ * after a pause. T3_ENTRY_TWO_STEP chooses a row with one press and a key
+ * with another, without waiting; see t3core_set_entry_mode().
+ * Call this before t3window_enable_resume().
+ *
+ * @param window  The T3Window whose mode to set.
+ * @param mode  The T3EntryMode to use.
+ */
+void t3window_set_entry_mode(T3Window * window, T3EntryMode mode);
+
+/**
+ * Enables the list of recently entered texts, which is kept in persistent
+ * storage under the given key. The text is added to the list when the
+ * keyboard closes; the list is only written then, and only if it changed.
+ *
+ * Recent texts are offered for picking with UP, SELECT or DOWN when the
+ * keyboard opens with no text. While typing, the most recent text that
+ * starts with the input is shown as a hint, and BACK offers the matches.
+ * BACK while they are offered accepts the text; a double press of BACK
+ * goes back to the keys.
+ *
+ * @param window  The T3Window to enable the list for.
+ * @param persistKey  The persistent storage key to keep the list under.
+ *                    It takes up to T3_MRU_MAX_BYTES bytes.
+ */
+void t3window_enable_mru(T3Window * window, uint32_t persistKey);
+
+/**
+ * Enables learning the words of the accepted texts and how often they are
+ * used. The table is kept in persistent storage under the given key and is
+ * only written when the keyboard closes, if it changed. Counts are halved
+ * every T3_WORDS_DECAY_PERIOD accepted texts so unused words fade out.
+ *
+ * The best completions of the word being entered, merged with those of the
+ * dictionary set with t3window_set_dictionary(), are offered as candidates
+ * like the recent texts of t3window_enable_mru().
+ *
+ * @param window  The T3Window to enable learning for.
+ * @param persistKey  The persistent storage key to keep the table under.
+ *                    It takes up to T3_WORDS_MAX_BYTES bytes.
+ */
+void t3window_enable_words(T3Window * window, uint32_t persistKey);
+
+/**
+ * Sets a static dictionary to complete words from. The words are packed,
+ * most frequent first, each followed by a null, and the list is ended by an
+ * empty word:
+ *
+ *   const char myDictionary[] = "the\0to\0and\0you\0";
+ *
+ * Words that the user has entered a few times rank above all of them.
+ *
+ * @param window  The T3Window to set the dictionary of.
+ * @param dictionary  The packed words, up to 64KB, or null for none.
+ *                    It is not copied and must outlive the window.
+ */
+void t3window_set_dictionary(T3Window * window, const char * dictionary);
+
+/**
+ * Loads a table of likely next words from a raw resource, as built by
+ * host/t3bigram.c. After the user enters a word and a space, the words most
+ * likely to follow it are offered through BACK, and one press enters one.
+ * The table is kept in memory until the window is destroyed, replacing any
+ * table loaded before.
+ *
+ * @param window  The T3Window to load the table into.
+ * @param resourceId  The resource ID of the table, such as RESOURCE_ID_NEXT.
+ * @return Whether the table was loaded. False if it is invalid or does not
+ *         fit in memory.
+ */
+bool t3window_load_bigram(T3Window * window, uint32_t resourceId);
+
+/**
+ * Keeps the text and keyboard state in persistent storage under the given
+ * key while the window is hidden, such as when the app is interrupted by a
+ * notification or killed, and restores any state that was kept. Call this
+ * right after t3window_create(). A pending key resumes with the time it had
+ * left. The state is discarded once the user accepts the text.
+ *
+ * @param window  The T3Window to keep the state of.
+ * @param persistKey  The persistent storage key to keep the state under.
+ *                    It takes up to T3_SNAPSHOT_MAX_BYTES bytes.
+ * @return Whether a state was restored, in which case t3window_set_text()
+ *         should not be called.
+ */
+bool t3window_enable_resume(T3Window * window, uint32_t persistKey);
+
+/**
+ * Registers a snippet. When an abbreviation is entered followed by one of
+ * T3_SNIPPET_TRIGGERS, such as a space, it is replaced by its expansion,
+ * unless that would not fit in T3_MAXLENGTH bytes. A double press of BACK
+ * right after an expansion puts back what was typed.
+ *
+ * @param window  The T3Window to add the snippet to.
+ * @param abbreviation  The abbreviation, without triggers.
+ * @param expansion  The text to replace it with.
+ *                   Neither string is copied, so both must outlive the window.
+ * @return Whether the snippet was added. False if T3_SNIPPET_CAPACITY
+ *         snippets are already registered.
+ */
+bool t3window_add_snippet(T3Window * window, const char * abbreviation, const char * expansion);
+
+/**
+ * Registers the snippets stored in a raw resource. The resource holds an
+ * abbreviation and its expansion for each snippet, each terminated by a
+ * newline or a null, so it may be a plain text file:
+ *
+ *   omw
+ *   on my way
+ *   rl
+ *   running late
+ *
+ * The resource is loaded into RAM and kept until the window is destroyed.
+ *
+ * @param window  The T3Window to add the snippets to.
+ * @param resourceId  The RESOURCE_ID_* of the resource.
+ * @return The number of snippets added.
+ */
+uint8_t t3window_load_snippets(T3Window * window, uint32_t resourceId);
+
+/**
+ * Expands the initials of recent texts of two or more words as well, so
+ * "on my way" may be entered as "omw ", once t3window_enable_mru() is
+ * called. Initials that spell a learned or dictionary word of
+ * t3window_enable_words() are skipped. Off by default.
+ *
+ * @param window  The T3Window to enable learned snippets for.
+ */
+void t3window_enable_learned_snippets(T3Window * window);
+
+#if T3_COLLECT_STATS
+/**
+ * Gets the activity counters of the T3Window since it was created or
+ * since t3window_reset_stats() was last called.
+ *
+ * @param window  The T3Window whose counters to get.
+ * @param stats  The T3Stats to fill in.
+ */
+void t3window_get_stats(const T3Window * window, T3Stats * stats);
+
+/**
+ * Resets the activity counters of the T3Window to zero.
+ *
+ * @param window  The T3Window whose counters to reset.
+ */
+void t3window_reset_stats(T3Window * window);
+#endif
+
 /**
  * Gets the input text from the T3Window.
  *
@@ -0,0 +1,375 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#include <string.h>
+#include "T3Words.h"
+
+#define _T3_WORDS_VERSION 1
+#define _T3_LEARNED_WEIGHT 64
+#define _T3_DICTIONARY_TOP_SCORE 127
+#define _T3_WORDS_MAX_REFILL 256
+
+void _t3_countWord(T3Words * words, const char * word, uint8_t length);
+uint8_t _t3_findWord(const T3Words * words, const char * word, uint8_t length);
+void _t3_decay(T3Words * words);
+void _t3_rebuildIndex(T3Words * words);
+void _t3_indexWord(T3Words * words, uint16_t ref, const char * text, uint16_t score);
+uint16_t _t3_dictionaryScore(uint16_t rank);
+uint16_t _t3_prefixBucket(const char * prefix, uint8_t length);
+uint8_t _t3_byteClass(char c);
+const char * _t3_wordText(const T3Words * words, uint16_t ref);
+void _t3_addCompletion(T3Words * words, const char * word, const char * prefix, uint8_t prefixLength,
+					   T3Candidate * candidates, const char ** added, uint8_t * found);
+bool _t3_sameWord(const char * text, const char * word, uint8_t length);
+bool _t3_samePrefix(const char * text, const char * prefix, uint8_t length);
+char _t3_lowerCase(char c);
+char _t3_upperCase(char c);
+
+void t3words_init(T3Words * words) {
+	words->count = 0;
+	words->closes = 0;
+	words->changed = false;
+	words->dictionary = NULL;
+	_t3_rebuildIndex(words);
+}
+
+void t3words_set_dictionary(T3Words * words, const char * dictionary) {
+	words->dictionary = dictionary;
+	_t3_rebuildIndex(words);
+}
+
+void t3words_learn(T3Words * words, const char * text) {
+	uint8_t count = words->count;
+	bool changed = false;
+	for(uint8_t start = 0; text[start] != '\0'; ) {
+		uint8_t end = start;
+		while(text[end] != '\0' && strchr(T3_WORD_SEPARATORS, text[end]) == NULL)
+			++end;
+		if(end - start >= 2 && end - start <= T3_WORDS_MAX_WORD_BYTES) {
+			_t3_countWord(words, &text[start], end - start);
+			changed = true;
+		}
+		start = text[end] != '\0' ? end + 1 : end;
+	}
+	
+	if(++(words->closes) >= T3_WORDS_DECAY_PERIOD) {
+		words->closes = 0;
+		_t3_decay(words);
+		changed = true;
+	}
+	
+	// The ranking is only rebuilt here, never while typing
+	if(changed || words->count != count) {
+		words->changed = true;
+		_t3_rebuildIndex(words);
+	}
+}
+
+uint8_t t3words_complete(T3Words * words, const char * text, uint8_t length,
+						 T3Candidate * candidates, uint8_t max) {
+	uint8_t start = length;
+	while(start > 0 && strchr(T3_WORD_SEPARATORS, text[start - 1]) == NULL)
+		--start;
+	uint8_t prefixLength = length - start;
+	if(prefixLength == 0)
+		return 0;
+	if(max > T3_MAX_CANDIDATES)
+		max = T3_MAX_CANDIDATES;
+	
+	// The bucket of the first two bytes holds the best words that start with
+	// them, whatever the length of the prefix
+	const char * prefix = &text[start];
+	const uint16_t * bucket = words->buckets[_t3_prefixBucket(prefix, prefixLength < 2 ? prefixLength : 2)];
+	const char * added[T3_MAX_CANDIDATES];
+	uint8_t found = 0;
+	for(uint8_t i = 0; i < _T3_WORDS_PER_BUCKET && found < max && bucket[i] != _T3_WORD_NONE; ++i)
+		_t3_addCompletion(words, _t3_wordText(words, bucket[i]), prefix, prefixLength, candidates, added, &found);
+	
+	// A full bucket may have left out the best words of a longer prefix. The
+	// dictionary is in rank order, so the scan picks up after the last of its
+	// words in the bucket, for a bounded number of words.
+	if(found < max && prefixLength > 2 && bucket[_T3_WORDS_PER_BUCKET - 1] != _T3_WORD_NONE) {
+		for(uint8_t i = 0; i < words->count && found < max; ++i)
+			_t3_addCompletion(words, words->words[i].text, prefix, prefixLength, candidates, added, &found);
+		
+		size_t offset = 0;
+		for(uint8_t i = 0; i < _T3_WORDS_PER_BUCKET; ++i)
+			if(bucket[i] >= T3_WORDS_CAPACITY) {
+				offset = bucket[i] - T3_WORDS_CAPACITY;
+				offset += strlen(&words->dictionary[offset]) + 1;
+			}
+		for(uint16_t n = 0; words->dictionary != NULL && words->dictionary[offset] != '\0'
+			&& n < _T3_WORDS_MAX_REFILL && found < max; ++n) {
+			_t3_addCompletion(words, &words->dictionary[offset], prefix, prefixLength, candidates, added, &found);
+			offset += strlen(&words->dictionary[offset]) + 1;
+		}
+	}
+	return found;
+}
+
+bool t3words_contains(const T3Words * words, const char * word, uint8_t length) {
+	for(uint8_t i = 0; i < words->count; ++i)
+		if(_t3_sameWord(words->words[i].text, word, length))
+			return true;
+	
+	for(size_t offset = 0; words->dictionary != NULL && words->dictionary[offset] != '\0'; ) {
+		if(_t3_sameWord(&words->dictionary[offset], word, length))
+			return true;
+		offset += strlen(&words->dictionary[offset]) + 1;
+	}
+	return false;
+}
+
+size_t t3words_encode(T3Words * words, uint8_t * buffer, size_t size) {
+	if(size < 3)
+		return 0;
+	
+	// Write the most frequent words first, so that the least frequent ones
+	// are dropped if the budget runs out.
+	uint8_t order[T3_WORDS_CAPACITY];
+	for(uint8_t i = 0; i < words->count; ++i) {
+		uint8_t j = i;
+		for(; j > 0 && words->words[order[j - 1]].count < words->words[i].count; --j)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+	
+	// Layout: version, closes, count, then for each word its count, length and bytes
+	size_t used = 3;
+	uint8_t count = 0;
+	for(; count < words->count; ++count) {
+		const T3Word * word = &words->words[order[count]];
+		uint8_t length = strlen(word->text);
+		if(used + 2 + length > size)
+			break;
+		buffer[used++] = word->count;
+		buffer[used++] = length;
+		memcpy(&buffer[used], word->text, length);
+		used += length;
+	}
+	buffer[0] = _T3_WORDS_VERSION;
+	buffer[1] = words->closes;
+	buffer[2] = count;
+	words->changed = false;
+	return used;
+}
+
+bool t3words_decode(T3Words * words, const uint8_t * buffer, size_t size) {
+	words->count = 0;
+	words->closes = 0;
+	words->changed = false;
+	bool valid = size >= 3 && buffer[0] == _T3_WORDS_VERSION && buffer[2] <= T3_WORDS_CAPACITY;
+	
+	size_t used = 3;
+	for(uint8_t i = 0; valid && i < buffer[2]; ++i) {
+		if(used + 2 > size || buffer[used + 1] > T3_WORDS_MAX_WORD_BYTES
+			|| used + 2 + buffer[used + 1] > size) {
+			valid = false;
+			break;
+		}
+		T3Word * word = &words->words[i];
+		word->count = buffer[used];
+		uint8_t length = buffer[used + 1];
+		memcpy(word->text, &buffer[used + 2], length);
+		word->text[length] = '\0';
+		used += 2 + length;
+	}
+	
+	if(valid) {
+		words->count = buffer[2];
+		words->closes = buffer[1];
+	}
+	_t3_rebuildIndex(words);
+	return valid;
+}
+
+void _t3_countWord(T3Words * words, const char * word, uint8_t length) {
+	uint8_t index = _t3_findWord(words, word, length);
+	if(index == words->count) {
+		if(words->count < T3_WORDS_CAPACITY)
+			++(words->count);
+		else {
+			// Replace the least frequent word
+			index = 0;
+			for(uint8_t i = 1; i < words->count; ++i)
+				if(words->words[i].count < words->words[index].count)
+					index = i;
+		}
+		memcpy(words->words[index].text, word, length);
+		words->words[index].text[length] = '\0';
+		words->words[index].count = 0;
+	}
+	
+	if(words->words[index].count == 255) {
+		// Halving forgets the words that reach zero and moves the rest up,
+		// but this one is kept with a count of 127
+		_t3_decay(words);
+		index = _t3_findWord(words, word, length);
+	}
+	++(words->words[index].count);
+}
+
+uint8_t _t3_findWord(const T3Words * words, const char * word, uint8_t length) {
+	uint8_t index = 0;
+	while(index < words->count && (strncmp(words->words[index].text, word, length) != 0
+		|| words->words[index].text[length] != '\0'))
+		++index;
+	return index;
+}
+
+void _t3_decay(T3Words * words) {
+	// Halve every count, forgetting the words that reach zero
+	uint8_t kept = 0;
+	for(uint8_t i = 0; i < words->count; ++i) {
+		words->words[i].count /= 2;
+		if(words->words[i].count > 0)
+			words->words[kept++] = words->words[i];
+	}
+	words->count = kept;
+}
+
+void _t3_rebuildIndex(T3Words * words) {
+	for(uint16_t b = 0; b < _T3_WORD_BUCKETS; ++b)
+		for(uint8_t i = 0; i < _T3_WORDS_PER_BUCKET; ++i)
+			words->buckets[b][i] = _T3_WORD_NONE;
+	
+	// A learned word that is also in the dictionary adds up both scores,
+	// so those are merged before anything is indexed
+	for(uint8_t i = 0; i < words->count; ++i)
+		words->words[i].score = words->words[i].count * _T3_LEARNED_WEIGHT;
+	uint16_t rank = 0;
+	for(uint16_t offset = 0; words->dictionary != NULL && words->dictionary[offset] != '\0'
+		&& offset < _T3_WORD_NONE - T3_WORDS_CAPACITY; ++rank) {
+		for(uint8_t i = 0; i < words->count; ++i)
+			if(strcmp(words->words[i].text, &words->dictionary[offset]) == 0)
+				words->words[i].score += _t3_dictionaryScore(rank);
+		offset += strlen(&words->dictionary[offset]) + 1;
+	}
+	
+	// Learned words are referred to by index, dictionary words by offset
+	for(uint8_t i = 0; i < words->count; ++i)
+		_t3_indexWord(words, i, words->words[i].text, words->words[i].score);
+	
+	rank = 0;
+	for(uint16_t offset = 0; words->dictionary != NULL && words->dictionary[offset] != '\0'
+		&& offset < _T3_WORD_NONE - T3_WORDS_CAPACITY; ++rank) {
+		_t3_indexWord(words, T3_WORDS_CAPACITY + offset, &words->dictionary[offset], _t3_dictionaryScore(rank));
+		offset += strlen(&words->dictionary[offset]) + 1;
+	}
+}
+
+void _t3_indexWord(T3Words * words, uint16_t ref, const char * text, uint16_t score) {
+	// Index the prefixes of one and two bytes that the word is longer than
+	for(uint8_t length = 1; length <= 2 && text[length - 1] != '\0' && text[length] != '\0'; ++length) {
+		uint16_t * bucket = words->buckets[_t3_prefixBucket(text, length)];
+		
+		// Dictionary words come in rank order after all learned words, so an
+		// entry ranks at least as high unless it is a learned word of lower
+		// score. A dictionary word that was learned is already there.
+		uint8_t i = 0;
+		bool indexed = false;
+		while(i < _T3_WORDS_PER_BUCKET && bucket[i] != _T3_WORD_NONE && !indexed
+			&& (bucket[i] >= T3_WORDS_CAPACITY || words->words[bucket[i]].score >= score)) {
+			indexed = strcmp(_t3_wordText(words, bucket[i]), text) == 0;
+			++i;
+		}
+		if(indexed || i == _T3_WORDS_PER_BUCKET)
+			continue;
+		
+		// Move the entries with lower scores down, dropping the last one
+		for(uint8_t j = _T3_WORDS_PER_BUCKET - 1; j > i; --j)
+			bucket[j] = bucket[j - 1];
+		bucket[i] = ref;
+	}
+}
+
+uint16_t _t3_dictionaryScore(uint16_t rank) {
+	return rank < _T3_DICTIONARY_TOP_SCORE ? _T3_DICTIONARY_TOP_SCORE - rank : 1;
+}
+
+uint16_t _t3_prefixBucket(const char * prefix, uint8_t length) {
+	// A prefix of one byte has a second class of its own, so it never
+	// shares a bucket with a prefix of two
+	uint16_t bucket = _t3_byteClass(prefix[0]) * _T3_WORD_SECOND_CLASSES;
+	if(length > 1)
+		bucket += 1 + _t3_byteClass(prefix[1]);
+	return bucket;
+}
+
+uint8_t _t3_byteClass(char c) {
+	if(c >= 'a' && c <= 'z')
+		return 1 + c - 'a';
+	else if(c >= 'A' && c <= 'Z')
+		return 1 + c - 'A';
+	return 0;
+}
+
+const char * _t3_wordText(const T3Words * words, uint16_t ref) {
+	return ref < T3_WORDS_CAPACITY ? words->words[ref].text : &words->dictionary[ref - T3_WORDS_CAPACITY];
+}
+
+void _t3_addCompletion(T3Words * words, const char * word, const char * prefix, uint8_t prefixLength,
+					   T3Candidate * candidates, const char ** added, uint8_t * found) {
+	if(!_t3_samePrefix(word, prefix, prefixLength) || word[prefixLength] == '\0')
+		return;
+	for(uint8_t i = 0; i < *found; ++i)
+		if(strcmp(added[i], word) == 0)
+			return;
+	
+	// Capitals that were typed are kept, and a prefix of two or more capitals
+	// completes in capitals. Capitals of the word itself are kept too, so
+	// "bo" completes to a learned "Bob". Words too long to pick in full are
+	// offered as stored.
+	size_t wordLength = strlen(word);
+	bool capitals = prefixLength >= 2;
+	for(uint8_t i = 0; i < prefixLength && capitals; ++i)
+		capitals = prefix[i] >= 'A' && prefix[i] <= 'Z';
+	const char * text = word;
+	if(wordLength <= T3_MAXLENGTH) {
+		char * completion = words->completions[*found];
+		for(size_t i = 0; i <= wordLength; ++i)
+			completion[i] = capitals || (i < prefixLength && prefix[i] >= 'A' && prefix[i] <= 'Z')
+				? _t3_upperCase(word[i]) : word[i];
+		text = completion;
+	}
+	
+	added[*found] = word;
+	candidates[*found].text = text;
+	candidates[*found].replace = prefixLength;
+	++(*found);
+}
+
+bool _t3_sameWord(const char * text, const char * word, uint8_t length) {
+	return _t3_samePrefix(text, word, length) && text[length] == '\0';
+}
+
+bool _t3_samePrefix(const char * text, const char * prefix, uint8_t length) {
+	// ASCII letters match regardless of case
+	for(uint8_t i = 0; i < length; ++i)
+		if(text[i] == '\0' || _t3_lowerCase(text[i]) != _t3_lowerCase(prefix[i]))
+			return false;
+	return true;
+}
+
+char _t3_lowerCase(char c) {
+	return c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+}
+
+char _t3_upperCase(char c) {
+	return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
@@ -0,0 +1,162 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. 
+ ******************************************************************************/
+
+#ifndef T3_WORDS_H
+#define T3_WORDS_H
+
+#include "T3Core.h"
+
+/**
+ * The number of learned words to remember. When full, the least frequent
+ * word makes room for a new one.
+ */
+#define T3_WORDS_CAPACITY 24
+
+/**
+ * The longest word, in bytes, that is learned.
+ */
+#define T3_WORDS_MAX_WORD_BYTES 12
+
+/**
+ * The number of accepted texts after which all learned counts are halved,
+ * so that words that are no longer used fade out.
+ */
+#define T3_WORDS_DECAY_PERIOD 16
+
+/**
+ * The largest number of bytes that the encoded table may take in persistent
+ * storage. The least frequent words that do not fit are dropped.
+ */
+#define T3_WORDS_MAX_BYTES 256
+
+#define _T3_WORD_FIRST_CLASSES 27   // A letter, or any other byte
+#define _T3_WORD_SECOND_CLASSES 28  // A letter, any other byte, or none
+#define _T3_WORD_BUCKETS (_T3_WORD_FIRST_CLASSES * _T3_WORD_SECOND_CLASSES)
+#define _T3_WORDS_PER_BUCKET T3_MAX_CANDIDATES
+#define _T3_WORD_NONE 0xFFFF
+
+/**
+ * A word learned from the accepted texts and how often it was used.
+ */
+typedef struct T3Word {
+	char text[T3_WORDS_MAX_WORD_BYTES + 1];
+	uint8_t count;
+	uint16_t score;  // The count merged with any dictionary rank, set with the index
+} T3Word;
+
+/**
+ * A table of learned word frequencies, merged with an optional static
+ * dictionary to complete the word being entered.
+ *
+ * Words are learned when the keyboard closes. The ranking is then rebuilt
+ * into an index of the best words for each prefix of one or two bytes, so
+ * completing a word only probes a single bucket of the index. Each ASCII
+ * letter, regardless of case, has buckets of its own; other bytes share one.
+ * The index takes 27 * 28 * T3_MAX_CANDIDATES two-byte references, about
+ * 4.5KB of RAM, so a T3Words takes about 5KB in all.
+ */
+typedef struct T3Words {
+	T3Word words[T3_WORDS_CAPACITY];
+	uint8_t count;
+	uint8_t closes;   // Accepted texts since the counts were last halved
+	bool changed;     // Whether the table changed since it was last encoded
+	const char * dictionary;
+	uint16_t buckets[_T3_WORD_BUCKETS][_T3_WORDS_PER_BUCKET];  // Best words first
+	char completions[T3_MAX_CANDIDATES][T3_MAXLENGTH + 1];      // Completions in the typed case
+} T3Words;
+
+/**
+ * Initializes an empty T3Words without a dictionary.
+ *
+ * @param words  The T3Words to initialize.
+ */
+void t3words_init(T3Words * words);
+
+/**
+ * Sets the static dictionary whose words are ranked along with the learned
+ * ones. A dictionary is a string of packed words, most frequent first, each
+ * followed by a null and ended by an empty word, such as "the\0to\0and\0".
+ * Its words rank below any word that the user has entered a few times.
+ *
+ * @param words  The T3Words to set the dictionary of.
+ * @param dictionary  The packed words, up to 64KB, or null for none.
+ *                    It is not copied and must outlive the T3Words.
+ */
+void t3words_set_dictionary(T3Words * words, const char * dictionary);
+
+/**
+ * Counts the words of an accepted text and rebuilds the index.
+ *
+ * @param words  The T3Words to update.
+ * @param text  The accepted text.
+ */
+void t3words_learn(T3Words * words, const char * text);
+
+/**
+ * Finds the best words that complete the last word of a text. ASCII letters
+ * match regardless of case, and the completions follow the case of the
+ * typed letters. The index only keeps the best few words of each bucket, so
+ * if a word longer than two bytes does not fill the candidates from a full
+ * bucket, the learned words and up to 256 more dictionary words after those
+ * in the bucket are scanned for it.
+ *
+ * @param words  The T3Words to search. The completions are kept in it until
+ *               the next call.
+ * @param text  The text being entered.
+ * @param length  The length of the text in bytes.
+ * @param candidates  The array to fill with the completions.
+ * @param max  The size of the candidates array.
+ * @return The number of candidates found.
+ */
+uint8_t t3words_complete(T3Words * words, const char * text, uint8_t length,
+						 T3Candidate * candidates, uint8_t max);
+
+/**
+ * Finds out whether a word was learned or is in the dictionary. ASCII
+ * letters are compared regardless of case. This scans the whole table and
+ * dictionary, so it is meant for when the keyboard closes, not for typing.
+ *
+ * @param words  The T3Words to search.
+ * @param word  The word to look for. It need not be terminated.
+ * @param length  The length of the word in bytes.
+ * @return Whether the word is known.
+ */
+bool t3words_contains(const T3Words * words, const char * word, uint8_t length);
+
+/**
+ * Encodes the learned words to a compact, versioned blob, most frequent
+ * first. Clears the changed flag.
+ *
+ * @param words  The T3Words to encode.
+ * @param buffer  The buffer to write to.
+ * @param size  The size of the buffer. Words that do not fit are dropped.
+ * @return The number of bytes written.
+ */
+size_t t3words_encode(T3Words * words, uint8_t * buffer, size_t size);
+
+/**
+ * Decodes a blob written by t3words_encode() and rebuilds the index.
+ *
+ * @param words  The T3Words to fill. The dictionary is kept.
+ * @param buffer  The encoded blob.
+ * @param size  The size of the blob in bytes.
+ * @return Whether the blob was valid. If not, no words are learned.
+ */
+bool t3words_decode(T3Words * words, const uint8_t * buffer, size_t size);
+
+#endif
@@ -0,0 +1,473 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************/
+
+/**
+ * Builds the next word table read by t3window_load_bigram() from a corpus of
+ * sample texts, one per line, such as sent messages.
+ *
+ * Build:
+ *   cc -std=c99 -O2 -I. -o t3bigram host/t3bigram.c T3Bigram.c -lm
+ *
+ * Usage:
+ *   t3bigram [-k NEXT] [-n WORDS] [-m COUNT] [-o OUT] CORPUS
+ *   -k NEXT     Stores up to NEXT next words per word, at most
+ *               T3_BIGRAM_MAX_NEXT. Defaults to T3_BIGRAM_MAX_NEXT.
+ *   -n WORDS    Stores the WORDS most frequent previous words. Defaults
+ *               to 256.
+ *   -m COUNT    Leaves out next words seen fewer than COUNT times after a
+ *               word. Defaults to 2.
+ *   -o OUT      Writes the table built from the whole corpus to OUT.
+ *
+ * The table is first built from the first 90% of the lines and tested on
+ * the rest through t3bigram_predict(), reporting how often the next word
+ * is the first prediction or any prediction, and how long a lookup takes.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "T3Bigram.h"
+
+#define _T3B_MAX_CORPUS_BYTES (16 * 1024 * 1024)
+#define _T3B_MAX_TABLE_BYTES 65535
+#define _T3B_TIMING_ROUNDS 20
+
+typedef struct _t3b_Word {
+	char * text;
+	uint8_t length;
+	uint32_t count;
+} _t3b_Word;
+
+typedef struct _t3b_Pair {
+	uint32_t prev;
+	uint32_t next;
+	uint32_t count;
+} _t3b_Pair;
+
+typedef struct _t3b_Model {
+	_t3b_Word * words;
+	uint32_t wordCount;
+	uint32_t wordCapacity;
+	uint32_t * wordIndex;
+	uint32_t wordIndexSize;
+	_t3b_Pair * pairs;
+	uint32_t pairCount;
+	uint32_t pairCapacity;
+	uint32_t * pairIndex;
+	uint32_t pairIndexSize;
+} _t3b_Model;
+
+typedef struct _t3b_Stats {
+	unsigned long pairs;
+	unsigned long offered;
+	unsigned long top1;
+	unsigned long topK;
+	double nanoseconds;
+} _t3b_Stats;
+
+uint8_t _t3b_next = T3_BIGRAM_MAX_NEXT;
+uint32_t _t3b_maxWords = 256;
+uint32_t _t3b_minCount = 2;
+
+bool _t3b_isSeparator(char c);
+uint8_t _t3b_token(const char * text, size_t end, size_t * i, char * word);
+void _t3b_train(_t3b_Model * model, const char * text, size_t size);
+uint32_t _t3b_addWord(_t3b_Model * model, const char * word, uint8_t length);
+void _t3b_addPair(_t3b_Model * model, uint32_t prev, uint32_t next);
+void _t3b_free(_t3b_Model * model);
+size_t _t3b_build(const _t3b_Model * model, uint8_t * table, size_t size);
+void _t3b_test(const T3Bigram * bigram, const char * text, size_t size, _t3b_Stats * stats);
+void _t3b_write16(uint8_t * data, uint16_t value);
+
+int main(int argc, char ** argv) {
+	const char * out = NULL;
+	int arg = 1;
+	for(;;) {
+		if(arg + 1 < argc && strcmp(argv[arg], "-k") == 0)
+			_t3b_next = (uint8_t)atoi(argv[arg + 1]);
+		else if(arg + 1 < argc && strcmp(argv[arg], "-n") == 0)
+			_t3b_maxWords = strtoul(argv[arg + 1], NULL, 10);
+		else if(arg + 1 < argc && strcmp(argv[arg], "-m") == 0)
+			_t3b_minCount = strtoul(argv[arg + 1], NULL, 10);
+		else if(arg + 1 < argc && strcmp(argv[arg], "-o") == 0)
+			out = argv[arg + 1];
+		else
+			break;
+		arg += 2;
+	}
+	if(arg + 1 != argc || _t3b_next < 1 || _t3b_next > T3_BIGRAM_MAX_NEXT || _t3b_maxWords < 1) {
+		fprintf(stderr, "usage: %s [-k NEXT] [-n WORDS] [-m COUNT] [-o OUT] CORPUS\n", argv[0]);
+		return 1;
+	}
+
+	FILE * file = fopen(argv[arg], "rb");
+	if(file == NULL) {
+		perror(argv[arg]);
+		return 1;
+	}
+	char * text = (char*)malloc(_T3B_MAX_CORPUS_BYTES);
+	size_t size = fread(text, 1, _T3B_MAX_CORPUS_BYTES, file);
+	fclose(file);
+
+	// Hold out the last tenth of the lines to test on
+	size_t split = size - size / 10;
+	while(split < size && text[split - 1] != '\n')
+		++split;
+
+	static uint8_t table[_T3B_MAX_TABLE_BYTES];
+	_t3b_Model model;
+	_t3b_train(&model, text, split);
+	size_t tableSize = _t3b_build(&model, table, sizeof(table));
+	_t3b_free(&model);
+
+	T3Bigram bigram;
+	if(tableSize == 0 || !t3bigram_init(&bigram, table, tableSize)) {
+		fprintf(stderr, "The table does not fit in %d bytes; use a smaller -n\n", _T3B_MAX_TABLE_BYTES);
+		return 1;
+	}
+	_t3b_Stats stats;
+	_t3b_test(&bigram, &text[split], size - split, &stats);
+
+	double pairs = stats.pairs > 0 ? stats.pairs : 1;
+	printf("held out  %10lu word pairs\n", stats.pairs);
+	printf("offered   %10lu  %5.1f%%\n", stats.offered, 100 * stats.offered / pairs);
+	printf("top 1     %10lu  %5.1f%%\n", stats.top1, 100 * stats.top1 / pairs);
+	printf("top %d     %10lu  %5.1f%%\n", bigram.next, stats.topK, 100 * stats.topK / pairs);
+	printf("lookup    %10.0f ns\n", stats.nanoseconds);
+
+	if(out != NULL) {
+		_t3b_train(&model, text, size);
+		tableSize = _t3b_build(&model, table, sizeof(table));
+		_t3b_free(&model);
+		if(tableSize == 0 || !t3bigram_init(&bigram, table, tableSize)) {
+			fprintf(stderr, "The table does not fit in %d bytes; use a smaller -n\n", _T3B_MAX_TABLE_BYTES);
+			return 1;
+		}
+
+		file = fopen(out, "wb");
+		if(file == NULL || fwrite(table, 1, tableSize, file) != tableSize) {
+			perror(out);
+			return 1;
+		}
+		fclose(file);
+	}
+
+	size_t entryBytes = (size_t)(2 + 3 * bigram.next) * bigram.entryCount;
+	printf("words     %10u\n", bigram.entryCount);
+	printf("buckets   %10lu bytes\n", (unsigned long)(2 * bigram.bucketCount));
+	printf("entries   %10lu bytes\n", (unsigned long)entryBytes);
+	printf("vocab     %10u bytes\n", bigram.vocabSize);
+	printf("total     %10lu bytes\n", (unsigned long)tableSize);
+	free(text);
+	return 0;
+}
+
+bool _t3b_isSeparator(char c) {
+	return c == '\0' || c == '\n' || c == '\r' || c == '\t' || strchr(T3_WORD_SEPARATORS, c) != NULL;
+}
+
+uint8_t _t3b_token(const char * text, size_t end, size_t * i, char * word) {
+	// Skips to the next word on the line, returning 0 at the end of a line
+	while(*i < end && _t3b_isSeparator(text[*i])) {
+		if(text[(*i)++] == '\n')
+			return 0;
+	}
+
+	size_t start = *i;
+	while(*i < end && !_t3b_isSeparator(text[*i]))
+		++*i;
+
+	// Words that could never be entered are kept as a break in the line
+	if(*i - start > T3_MAXLENGTH) {
+		word[0] = '\0';
+		return 0xFF;
+	}
+	uint8_t length = (uint8_t)(*i - start);
+	for(uint8_t j = 0; j < length; ++j) {
+		char c = text[start + j];
+		word[j] = (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+	}
+	word[length] = '\0';
+	return length;
+}
+
+void _t3b_train(_t3b_Model * model, const char * text, size_t size) {
+	memset(model, 0, sizeof(_t3b_Model));
+
+	char word[T3_MAXLENGTH + 1];
+	uint32_t prev = UINT32_MAX;
+	for(size_t i = 0; i < size; ) {
+		uint8_t length = _t3b_token(text, size, &i, word);
+		if(length == 0 || length == 0xFF) {
+			prev = UINT32_MAX;
+			continue;
+		}
+
+		uint32_t next = _t3b_addWord(model, word, length);
+		if(prev != UINT32_MAX)
+			_t3b_addPair(model, prev, next);
+		prev = next;
+	}
+}
+
+uint32_t _t3b_addWord(_t3b_Model * model, const char * word, uint8_t length) {
+	if(2 * (model->wordCount + 1) > model->wordIndexSize) {
+		uint32_t size = model->wordIndexSize ? 2 * model->wordIndexSize : 1024;
+		free(model->wordIndex);
+		model->wordIndex = (uint32_t*)malloc(size * sizeof(uint32_t));
+		memset(model->wordIndex, 0xFF, size * sizeof(uint32_t));
+		model->wordIndexSize = size;
+		for(uint32_t w = 0; w < model->wordCount; ++w) {
+			uint32_t slot = t3bigram_hash(model->words[w].text, model->words[w].length) & (size - 1);
+			while(model->wordIndex[slot] != UINT32_MAX)
+				slot = (slot + 1) & (size - 1);
+			model->wordIndex[slot] = w;
+		}
+	}
+
+	uint32_t slot = t3bigram_hash(word, length) & (model->wordIndexSize - 1);
+	for(; model->wordIndex[slot] != UINT32_MAX; slot = (slot + 1) & (model->wordIndexSize - 1)) {
+		_t3b_Word * entry = &model->words[model->wordIndex[slot]];
+		if(entry->length == length && memcmp(entry->text, word, length) == 0) {
+			++entry->count;
+			return model->wordIndex[slot];
+		}
+	}
+
+	if(model->wordCount == model->wordCapacity) {
+		model->wordCapacity = model->wordCapacity ? 2 * model->wordCapacity : 512;
+		model->words = (_t3b_Word*)realloc(model->words, model->wordCapacity * sizeof(_t3b_Word));
+	}
+	_t3b_Word * entry = &model->words[model->wordCount];
+	entry->text = (char*)malloc(length + 1);
+	memcpy(entry->text, word, length + 1);
+	entry->length = length;
+	entry->count = 1;
+	model->wordIndex[slot] = model->wordCount;
+	return model->wordCount++;
+}
+
+void _t3b_addPair(_t3b_Model * model, uint32_t prev, uint32_t next) {
+	if(2 * (model->pairCount + 1) > model->pairIndexSize) {
+		uint32_t size = model->pairIndexSize ? 2 * model->pairIndexSize : 4096;
+		free(model->pairIndex);
+		model->pairIndex = (uint32_t*)malloc(size * sizeof(uint32_t));
+		memset(model->pairIndex, 0xFF, size * sizeof(uint32_t));
+		model->pairIndexSize = size;
+		for(uint32_t p = 0; p < model->pairCount; ++p) {
+			uint32_t slot = (model->pairs[p].prev * 2654435761u ^ model->pairs[p].next) & (size - 1);
+			while(model->pairIndex[slot] != UINT32_MAX)
+				slot = (slot + 1) & (size - 1);
+			model->pairIndex[slot] = p;
+		}
+	}
+
+	uint32_t slot = (prev * 2654435761u ^ next) & (model->pairIndexSize - 1);
+	for(; model->pairIndex[slot] != UINT32_MAX; slot = (slot + 1) & (model->pairIndexSize - 1)) {
+		_t3b_Pair * pair = &model->pairs[model->pairIndex[slot]];
+		if(pair->prev == prev && pair->next == next) {
+			++pair->count;
+			return;
+		}
+	}
+
+	if(model->pairCount == model->pairCapacity) {
+		model->pairCapacity = model->pairCapacity ? 2 * model->pairCapacity : 2048;
+		model->pairs = (_t3b_Pair*)realloc(model->pairs, model->pairCapacity * sizeof(_t3b_Pair));
+	}
+	_t3b_Pair * pair = &model->pairs[model->pairCount];
+	pair->prev = prev;
+	pair->next = next;
+	pair->count = 1;
+	model->pairIndex[slot] = model->pairCount++;
+}
+
+void _t3b_free(_t3b_Model * model) {
+	for(uint32_t w = 0; w < model->wordCount; ++w)
+		free(model->words[w].text);
+	free(model->words);
+	free(model->wordIndex);
+	free(model->pairs);
+	free(model->pairIndex);
+}
+
+const _t3b_Model * _t3b_sortModel;
+
+int _t3b_byCount(const void * a, const void * b) {
+	uint32_t countA = _t3b_sortModel->words[*(const uint32_t*)a].count;
+	uint32_t countB = _t3b_sortModel->words[*(const uint32_t*)b].count;
+	return countA < countB ? 1 : countA > countB ? -1 : 0;
+}
+
+size_t _t3b_build(const _t3b_Model * model, uint8_t * table, size_t size) {
+	// The best next words of each previous word
+	uint32_t * best = (uint32_t*)malloc((size_t)model->wordCount * _t3b_next * sizeof(uint32_t));
+	uint32_t * total = (uint32_t*)calloc(model->wordCount, sizeof(uint32_t));
+	memset(best, 0xFF, (size_t)model->wordCount * _t3b_next * sizeof(uint32_t));
+	for(uint32_t p = 0; p < model->pairCount; ++p) {
+		const _t3b_Pair * pair = &model->pairs[p];
+		total[pair->prev] += pair->count;
+		if(pair->count < _t3b_minCount)
+			continue;
+
+		uint32_t * slots = &best[(size_t)pair->prev * _t3b_next];
+		int8_t i = _t3b_next - 1;
+		if(slots[i] != UINT32_MAX && model->pairs[slots[i]].count >= pair->count)
+			continue;
+		for(; i > 0 && (slots[i - 1] == UINT32_MAX || model->pairs[slots[i - 1]].count < pair->count); --i)
+			slots[i] = slots[i - 1];
+		slots[i] = p;
+	}
+
+	// Keep the most frequent previous words that predict anything
+	uint32_t * order = (uint32_t*)malloc(model->wordCount * sizeof(uint32_t));
+	uint32_t entryCount = 0;
+	for(uint32_t w = 0; w < model->wordCount; ++w)
+		if(best[(size_t)w * _t3b_next] != UINT32_MAX)
+			order[entryCount++] = w;
+	_t3b_sortModel = model;
+	qsort(order, entryCount, sizeof(uint32_t), _t3b_byCount);
+	if(entryCount > _t3b_maxWords)
+		entryCount = _t3b_maxWords;
+
+	uint32_t bucketCount = 1;
+	while(bucketCount < 2 * entryCount)
+		bucketCount *= 2;
+	size_t entryBytes = 2 + 3 * _t3b_next;
+	uint8_t * buckets = &table[T3_BIGRAM_HEADER_BYTES];
+	uint8_t * entries = buckets + 2 * bucketCount;
+	char * vocab = (char*)(entries + entryBytes * entryCount);
+	if(entryCount >= _T3_BIGRAM_NONE || (uint8_t*)vocab > table + size) {
+		free(best);
+		free(total);
+		free(order);
+		return 0;
+	}
+	memset(buckets, 0xFF, 2 * bucketCount);
+
+	// Each next word is stored once, remembering where by word index
+	uint16_t * offsets = (uint16_t*)malloc(model->wordCount * sizeof(uint16_t));
+	memset(offsets, 0xFF, model->wordCount * sizeof(uint16_t));
+	size_t vocabSize = 0;
+	size_t maxVocab = table + size - (uint8_t*)vocab;
+	bool fits = true;
+
+	// The most frequent words are placed first so they probe the least
+	for(uint32_t e = 0; e < entryCount && fits; ++e) {
+		const _t3b_Word * word = &model->words[order[e]];
+		uint32_t hash = t3bigram_hash(word->text, word->length);
+		uint32_t bucket = hash & (bucketCount - 1);
+		while(buckets[2 * bucket] != 0xFF || buckets[2 * bucket + 1] != 0xFF)
+			bucket = (bucket + 1) & (bucketCount - 1);
+		_t3b_write16(&buckets[2 * bucket], (uint16_t)e);
+
+		uint8_t * entry = &entries[e * entryBytes];
+		_t3b_write16(entry, hash >> 16);
+		for(uint8_t i = 0; i < _t3b_next; ++i) {
+			uint32_t p = best[(size_t)order[e] * _t3b_next + i];
+			uint8_t * slot = &entry[2 + 3 * i];
+			if(p == UINT32_MAX) {
+				_t3b_write16(slot, _T3_BIGRAM_NONE);
+				slot[2] = 0xFF;
+				continue;
+			}
+
+			const _t3b_Word * next = &model->words[model->pairs[p].next];
+			uint16_t * offset = &offsets[model->pairs[p].next];
+			if(*offset == _T3_BIGRAM_NONE) {
+				if(vocabSize + next->length + 1 > maxVocab || vocabSize >= _T3_BIGRAM_NONE) {
+					fits = false;
+					break;
+				}
+				*offset = (uint16_t)vocabSize;
+				memcpy(&vocab[vocabSize], next->text, next->length + 1);
+				vocabSize += next->length + 1;
+			}
+			_t3b_write16(slot, *offset);
+
+			double score = -16 * log2((double)model->pairs[p].count / total[order[e]]);
+			slot[2] = score > 254 ? 254 : (uint8_t)(score + 0.5);
+		}
+	}
+	free(best);
+	free(total);
+	free(order);
+	free(offsets);
+	if(!fits || vocabSize == 0)
+		return 0;
+
+	memcpy(table, "T3B", 3);
+	table[3] = 1;
+	table[4] = _t3b_next;
+	table[5] = 0;
+	_t3b_write16(&table[6], (uint16_t)bucketCount);
+	_t3b_write16(&table[8], (uint16_t)entryCount);
+	_t3b_write16(&table[10], (uint16_t)vocabSize);
+	return (uint8_t*)vocab + vocabSize - table;
+}
+
+void _t3b_test(const T3Bigram * bigram, const char * text, size_t size, _t3b_Stats * stats) {
+	memset(stats, 0, sizeof(_t3b_Stats));
+
+	// Each previous word is entered as the keyboard would see it
+	char prev[T3_MAXLENGTH + 1];
+	char word[T3_MAXLENGTH + 1];
+	uint8_t prevLength = 0;
+	T3Candidate candidates[T3_MAX_CANDIDATES];
+	clock_t elapsed = 0;
+	for(size_t i = 0; i < size; ) {
+		uint8_t length = _t3b_token(text, size, &i, word);
+		if(length == 0 || length == 0xFF) {
+			prevLength = 0;
+			continue;
+		}
+
+		if(prevLength > 0 && prevLength < T3_MAXLENGTH) {
+			prev[prevLength] = ' ';
+			clock_t start = clock();
+			uint8_t count = 0;
+			for(uint8_t r = 0; r < _T3B_TIMING_ROUNDS; ++r)
+				count = t3bigram_predict(bigram, prev, prevLength + 1, candidates, T3_MAX_CANDIDATES);
+			elapsed += clock() - start;
+
+			++stats->pairs;
+			if(count > 0)
+				++stats->offered;
+			for(uint8_t c = 0; c < count; ++c) {
+				if(strcmp(candidates[c].text, word) == 0) {
+					if(c == 0)
+						++stats->top1;
+					++stats->topK;
+					break;
+				}
+			}
+		}
+		memcpy(prev, word, length + 1);
+		prevLength = length;
+	}
+
+	if(stats->pairs > 0)
+		stats->nanoseconds = 1e9 * elapsed / CLOCKS_PER_SEC / stats->pairs / _T3B_TIMING_ROUNDS;
+}
+
+void _t3b_write16(uint8_t * data, uint16_t value) {
+	data[0] = value & 0xFF;
+	data[1] = value >> 8;
+}
@@ -0,0 +1,538 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************/
+
+/**
+ * A randomized driver for the T3 keyboard core that checks its invariants
+ * with assertions. Build it with AddressSanitizer, so that any read or write
+ * out of bounds fails as well:
+ *
+ * Build:
+ *   cc -std=c99 -g -fsanitize=address,undefined -I. -o t3fuzz host/t3fuzz.c T3Core.c T3Mru.c T3Snippets.c T3Words.c T3Bigram.c
+ *
+ * Usage:
+ *   t3fuzz [-g FILE] [COUNT [SEED]]
+ *                           Drives COUNT random events, one million by
+ *                           default, through the core and reports the rate.
+ *   -g FILE                 Predicts next words from the table in FILE, as
+ *                           written by t3bigram.
+ *
+ * Every built-in layout, including the 4x3 one, takes a turn in each
+ * keyboard set and in each entry mode. Events arrive in random bursts at
+ * random times, with recent texts, learned snippets and word completion
+ * attached. Now and then a click names no button, and the core must refuse
+ * to queue it. After each run of the queue, the driver checks that the layout
+ * is valid, that every key and candidate is a short, well-formed string and
+ * that the text fits in T3_MAXLENGTH bytes and ends on a whole character.
+ *
+ * Every _T3F_ROUND_TRIP_PERIOD events, and on random kills, the core is
+ * resumed from t3core_snapshot() into a fresh core, and the recent texts and
+ * learned words are encoded and decoded. Each must encode to the same bytes
+ * again. Corrupted snapshots and blobs are decoded as well and must either
+ * be rejected or yield a state within bounds.
+ *
+ * The rounds take turns with three next word tables: the one loaded with -g,
+ * a copy of it with its buckets and entries damaged, and a table with no
+ * empty bucket, on which every miss probes all the buckets. Without -g, the
+ * damaged copy is made of the full table. Words from the vocabulary and
+ * random words are looked up directly too, and every prediction must be a
+ * word of the vocabulary.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "T3Core.h"
+#include "T3Mru.h"
+#include "T3Snippets.h"
+#include "T3Words.h"
+#include "T3Bigram.h"
+
+#define _T3F_ROUND_EVENTS 4096
+#define _T3F_ROUND_TRIP_PERIOD 64
+#define _T3F_MAX_BURST 4
+#define _T3F_MAX_KEY_BYTES (_T3_MAX_CHARS_PER_KEY * _T3_MAX_CHAR_BYTES)
+#define _T3F_MAX_BIGRAM_BYTES 65536
+#define _T3F_FULL_BUCKETS 16
+
+typedef struct _t3f_Fuzz {
+	T3Core core;
+	T3Mru mru;
+	T3Snippets snippets;
+	T3Words words;
+	T3Bigram bigram;
+	bool hasBigram;
+	const char * layouts[6];
+	uint8_t mode;
+	uint32_t now;
+	bool timerArmed;
+	uint32_t timerDeadline;
+	unsigned long closes;
+	unsigned long resumes;
+} _t3f_Fuzz;
+
+const char * _t3f_layouts[] = {
+	T3_LAYOUT_LOWERCASE, T3_LAYOUT_UPPERCASE, T3_LAYOUT_NUMBERS,
+	T3_LAYOUT_PUNC, T3_LAYOUT_BRACKETS, T3_LAYOUT_LOWERCASE_EXTENDED
+};
+const uint8_t _t3f_counts[] = {2, 1, 3};
+char _t3f_snippetData[] = "omw\non my way\nbrb\nbe right back\n";
+const char _t3f_dictionary[] = "the\0to\0and\0you\0it\0in\0people\0be\0on\0";
+uint8_t _t3f_bigramData[_T3F_MAX_BIGRAM_BYTES];
+size_t _t3f_bigramSize = 0;
+uint8_t _t3f_fullData[_T3F_MAX_BIGRAM_BYTES];
+size_t _t3f_fullSize = 0;
+uint8_t _t3f_damagedData[_T3F_MAX_BIGRAM_BYTES];
+uint32_t _t3f_seed = 1;
+
+void _t3f_init(_t3f_Fuzz * fuzz, unsigned long round);
+void _t3f_initCore(_t3f_Fuzz * fuzz, T3Core * core);
+void _t3f_step(_t3f_Fuzz * fuzz);
+void _t3f_run(_t3f_Fuzz * fuzz);
+void _t3f_check(const _t3f_Fuzz * fuzz, const T3Core * core);
+void _t3f_resume(_t3f_Fuzz * fuzz);
+void _t3f_checkMru(T3Mru * mru);
+void _t3f_checkWords(T3Words * words);
+void _t3f_checkBigram(const T3Bigram * bigram);
+bool _t3f_loadBigram(const char * path);
+void _t3f_fillBigram(void);
+void _t3f_damageBigram(const uint8_t * data, size_t size);
+bool _t3f_validText(const char * text, size_t maxBytes);
+void _t3f_corrupt(uint8_t * buffer, size_t * size, size_t capacity);
+uint32_t _t3f_random(void);
+
+int main(int argc, char ** argv) {
+	int arg = 1;
+	if(arg + 1 < argc && strcmp(argv[arg], "-g") == 0) {
+		if(!_t3f_loadBigram(argv[arg + 1]))
+			return 1;
+		arg += 2;
+	}
+	unsigned long count = arg < argc ? strtoul(argv[arg], NULL, 10) : 1000000;
+	if(arg + 1 < argc)
+		_t3f_seed = strtoul(argv[arg + 1], NULL, 10) | 1;
+	if(arg + 2 < argc || count == 0) {
+		fprintf(stderr, "usage: %s [-g FILE] [COUNT [SEED]]\n", argv[0]);
+		return 1;
+	}
+	_t3f_fillBigram();
+
+	static _t3f_Fuzz fuzz;
+	unsigned long closes = 0;
+	unsigned long resumes = 0;
+	clock_t start = clock();
+	for(unsigned long i = 0; i < count; ++i) {
+		if(i % _T3F_ROUND_EVENTS == 0) {
+			closes += fuzz.closes;
+			resumes += fuzz.resumes;
+			_t3f_init(&fuzz, i / _T3F_ROUND_EVENTS);
+		}
+		_t3f_step(&fuzz);
+		if(i % _T3F_ROUND_TRIP_PERIOD == _T3F_ROUND_TRIP_PERIOD - 1) {
+			_t3f_resume(&fuzz);
+			_t3f_checkMru(&fuzz.mru);
+			_t3f_checkWords(&fuzz.words);
+			if(fuzz.hasBigram)
+				_t3f_checkBigram(&fuzz.bigram);
+		}
+	}
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("events    %10lu  %.0f per second\n", count, seconds > 0 ? count / seconds : 0);
+	printf("closes    %10lu\n", closes + fuzz.closes);
+	printf("resumes   %10lu\n", resumes + fuzz.resumes);
+	return 0;
+}
+
+void _t3f_init(_t3f_Fuzz * fuzz, unsigned long round) {
+	// Rotate the layouts through the sets, so each is first of its set,
+	// in the middle of a cycle and alone, and alternate the entry modes
+	for(uint8_t i = 0; i < 6; ++i)
+		fuzz->layouts[i] = _t3f_layouts[(round / 2 + i) % 6];
+	fuzz->mode = round % 2 == 0 ? T3_ENTRY_MULTITAP : T3_ENTRY_TWO_STEP;
+
+	t3mru_init(&fuzz->mru);
+	t3snippets_init(&fuzz->snippets);
+	t3snippets_add_packed(&fuzz->snippets, _t3f_snippetData, strlen(_t3f_snippetData));
+	t3snippets_set_learning(&fuzz->snippets, true);
+	t3words_init(&fuzz->words);
+	t3words_set_dictionary(&fuzz->words, _t3f_dictionary);
+	
+	// The tables take turns, each with both entry modes
+	uint8_t table = round % 3;
+	bool loaded = _t3f_bigramSize > 0;
+	if(table == 0)
+		fuzz->hasBigram = loaded && t3bigram_init(&fuzz->bigram, _t3f_bigramData, _t3f_bigramSize);
+	else if(table == 1) {
+		size_t size = loaded ? _t3f_bigramSize : _t3f_fullSize;
+		_t3f_damageBigram(loaded ? _t3f_bigramData : _t3f_fullData, size);
+		fuzz->hasBigram = t3bigram_init(&fuzz->bigram, _t3f_damagedData, size);
+		assert(fuzz->hasBigram);
+	} else {
+		fuzz->hasBigram = t3bigram_init(&fuzz->bigram, _t3f_fullData, _t3f_fullSize);
+		assert(fuzz->hasBigram);
+	}
+	_t3f_initCore(fuzz, &fuzz->core);
+
+	fuzz->now = _t3f_random();
+	fuzz->timerArmed = false;
+	fuzz->timerDeadline = 0;
+	fuzz->closes = 0;
+	fuzz->resumes = 0;
+	t3core_post(&fuzz->core, T3_EVENT_OPEN, 0, fuzz->now);
+	_t3f_run(fuzz);
+}
+
+void _t3f_initCore(_t3f_Fuzz * fuzz, T3Core * core) {
+	bool valid = t3core_init(core, &fuzz->layouts[0], _t3f_counts[0], &fuzz->layouts[2], _t3f_counts[1],
+		&fuzz->layouts[3], _t3f_counts[2]);
+	assert(valid);
+	t3core_set_entry_mode(core, fuzz->mode);
+	t3core_set_mru(core, &fuzz->mru);
+	t3core_set_snippets(core, &fuzz->snippets);
+	t3core_set_words(core, &fuzz->words);
+	t3core_set_bigram(core, fuzz->hasBigram ? &fuzz->bigram : NULL);
+}
+
+void _t3f_step(_t3f_Fuzz * fuzz) {
+	// Fire the timer if its deadline passed, as a backend would
+	fuzz->now += _t3f_random() % 400;
+	if(fuzz->timerArmed && (int32_t)(fuzz->now - fuzz->timerDeadline) >= 0) {
+		fuzz->timerArmed = false;
+		t3core_post(&fuzz->core, T3_EVENT_TIMEOUT, 0, fuzz->timerDeadline);
+		_t3f_run(fuzz);
+	}
+
+	uint32_t choice = _t3f_random() % 100;
+	if(choice < 2) {
+		_t3f_resume(fuzz);
+		return;
+	} else if(choice < 3) {
+		fuzz->mode = fuzz->mode == T3_ENTRY_MULTITAP ? T3_ENTRY_TWO_STEP : T3_ENTRY_MULTITAP;
+		t3core_set_entry_mode(&fuzz->core, fuzz->mode);
+		fuzz->timerArmed = false;
+	}
+
+	uint8_t burst = 1 + _t3f_random() % _T3F_MAX_BURST;
+	for(uint8_t i = 0; i < burst; ++i) {
+		// Buttons out of range must be turned away, since the queue never
+		// holds more than a burst
+		static const uint8_t invalid[] = {0, 4, 255};
+		uint8_t button = 1 + _t3f_random() % 3;
+		bool valid = _t3f_random() % 32 != 0;
+		if(!valid)
+			button = invalid[_t3f_random() % sizeof(invalid)];
+		choice = _t3f_random() % 100;
+		if(choice < 60)
+			assert(t3core_post(&fuzz->core, T3_EVENT_CLICK, button, fuzz->now) == valid);
+		else if(choice < 70)
+			assert(t3core_post(&fuzz->core, T3_EVENT_LONGCLICK, button, fuzz->now) == valid);
+		else if(choice < 80)
+			t3core_post(&fuzz->core, T3_EVENT_BACKSPACE, 0, fuzz->now);
+		else if(choice < 86)
+			t3core_post(&fuzz->core, T3_EVENT_BACK, 0, fuzz->now);
+		else if(choice < 96)
+			t3core_post(&fuzz->core, T3_EVENT_TIMEOUT, 0, fuzz->now);  // Early or stale
+		else
+			t3core_post(&fuzz->core, T3_EVENT_OPEN, 0, fuzz->now);
+	}
+	_t3f_run(fuzz);
+}
+
+void _t3f_run(_t3f_Fuzz * fuzz) {
+	T3Effects effects;
+	t3core_run(&fuzz->core, &effects);
+	fuzz->timerArmed = effects.timerWanted;
+	fuzz->timerDeadline = effects.deadline;
+	if(effects.timerWanted)
+		assert((int32_t)(effects.deadline - fuzz->now) <= 1000);
+	_t3f_check(fuzz, &fuzz->core);
+
+	if(effects.close) {
+		// Open the keyboard again with no text, as an app would
+		++(fuzz->closes);
+		t3core_set_text(&fuzz->core, "");
+		t3core_post(&fuzz->core, T3_EVENT_OPEN, 0, fuzz->now);
+		t3core_run(&fuzz->core, &effects);
+		fuzz->timerArmed = effects.timerWanted;
+		fuzz->timerDeadline = effects.deadline;
+		_t3f_check(fuzz, &fuzz->core);
+	}
+}
+
+void _t3f_check(const _t3f_Fuzz * fuzz, const T3Core * core) {
+	// Every built-in layout is valid and fits the grid
+	assert(core->keyboardValid);
+	assert(core->rows >= 1 && core->rows <= T3_MAX_ROWS);
+	assert(core->cols >= 1 && core->cols <= T3_MAX_COLS);
+	assert(core->row <= core->rows && core->col <= core->cols);
+	assert(core->entryMode == fuzz->mode);
+
+	const char * text = t3core_get_text(core);
+	assert(strlen(text) == core->inputLength);
+	assert(_t3f_validText(text, T3_MAXLENGTH));
+
+	bool picking = t3core_is_picking(core);
+	for(uint8_t row = 1; row <= T3_MAX_ROWS; ++row)
+		for(uint8_t col = 1; col <= T3_MAX_COLS; ++col) {
+			const char * key = t3core_get_key_text(core, row, col);
+			if(picking || row > core->rows || col > core->cols)
+				assert(key == NULL);
+			else if(core->selectionMode)
+				assert(key == NULL || _t3f_validText(key, _T3_MAX_CHAR_BYTES));
+			else
+				assert(key != NULL && key[0] != '\0' && _t3f_validText(key, _T3F_MAX_KEY_BYTES));
+			if(t3core_is_key_pressed(core, row, col))
+				assert(row == core->row && row <= core->rows && col <= core->cols);
+		}
+
+	uint8_t candidates = t3core_get_candidate_count(core);
+	assert(candidates <= T3_MAX_CANDIDATES);
+	assert(!picking || candidates > 0);
+	for(uint8_t i = 0; i < T3_MAX_CANDIDATES; ++i) {
+		const char * candidate = t3core_get_candidate(core, i);
+		if(i >= candidates)
+			assert(candidate == NULL);
+		else {
+			assert(candidate != NULL && _t3f_validText(candidate, T3_MAXLENGTH));
+			assert(core->candidates[i].replace <= core->inputLength);
+		}
+	}
+}
+
+void _t3f_resume(_t3f_Fuzz * fuzz) {
+	// Kill the core and resume it, as when the app is interrupted
+	uint8_t blob[T3_SNAPSHOT_MAX_BYTES];
+	size_t size = t3core_snapshot(&fuzz->core, fuzz->now, blob, sizeof(blob));
+	assert(size <= sizeof(blob));
+
+	static T3Core core;
+	_t3f_initCore(fuzz, &core);
+	if(size > 0) {
+		assert(t3core_restore(&core, fuzz->now, blob, size));
+		uint8_t again[T3_SNAPSHOT_MAX_BYTES];
+		assert(t3core_snapshot(&core, fuzz->now, again, sizeof(again)) == size);
+		assert(memcmp(blob, again, size) == 0);
+		assert(strcmp(t3core_get_text(&core), t3core_get_text(&fuzz->core)) == 0);
+
+		// A corrupted snapshot is rejected without a change, or restores a
+		// state within bounds. The text itself is not checked for UTF-8.
+		static T3Core corrupted;
+		_t3f_initCore(fuzz, &corrupted);
+		_t3f_corrupt(blob, &size, sizeof(blob));
+		if(t3core_restore(&corrupted, fuzz->now, blob, size)) {
+			assert(corrupted.keyboardValid && corrupted.inputLength <= T3_MAXLENGTH);
+			assert(strlen(t3core_get_text(&corrupted)) == corrupted.inputLength);
+			assert(corrupted.row <= corrupted.rows && corrupted.col <= corrupted.cols);
+		} else
+			assert(t3core_get_text(&corrupted)[0] == '\0' && corrupted.row == 0);
+	}
+
+	fuzz->core = core;
+	fuzz->timerArmed = false;
+	++(fuzz->resumes);
+	_t3f_run(fuzz);
+}
+
+void _t3f_checkMru(T3Mru * mru) {
+	uint8_t blob[T3_MRU_MAX_BYTES];
+	size_t size = t3mru_encode(mru, blob, sizeof(blob));
+	assert(size <= sizeof(blob));
+
+	static T3Mru decoded;
+	assert(t3mru_decode(&decoded, blob, size));
+	assert(decoded.count <= mru->count);
+	for(uint8_t i = 0; i < decoded.count; ++i)
+		assert(strcmp(decoded.entries[i], mru->entries[i]) == 0);
+
+	uint8_t again[T3_MRU_MAX_BYTES];
+	assert(t3mru_encode(&decoded, again, sizeof(again)) == size);
+	assert(memcmp(blob, again, size) == 0);
+
+	_t3f_corrupt(blob, &size, sizeof(blob));
+	if(t3mru_decode(&decoded, blob, size))
+		for(uint8_t i = 0; i < decoded.count; ++i)
+			assert(strlen(decoded.entries[i]) <= T3_MAXLENGTH);
+	else
+		assert(decoded.count == 0);
+}
+
+void _t3f_checkWords(T3Words * words) {
+	uint8_t blob[T3_WORDS_MAX_BYTES];
+	size_t size = t3words_encode(words, blob, sizeof(blob));
+	assert(size <= sizeof(blob));
+
+	static T3Words decoded;
+	t3words_init(&decoded);
+	t3words_set_dictionary(&decoded, _t3f_dictionary);
+	assert(t3words_decode(&decoded, blob, size));
+	assert(decoded.count <= words->count);
+
+	uint8_t again[T3_WORDS_MAX_BYTES];
+	assert(t3words_encode(&decoded, again, sizeof(again)) == size);
+	assert(memcmp(blob, again, size) == 0);
+
+	_t3f_corrupt(blob, &size, sizeof(blob));
+	if(t3words_decode(&decoded, blob, size))
+		for(uint8_t i = 0; i < decoded.count; ++i)
+			assert(strlen(decoded.words[i].text) <= T3_WORDS_MAX_WORD_BYTES);
+	else
+		assert(decoded.count == 0);
+
+	// Completions of any prefix start with it, in either case
+	T3Candidate candidates[T3_MAX_CANDIDATES];
+	char prefix[3];
+	for(uint8_t i = 0; i < sizeof(prefix); ++i)
+		prefix[i] = (_t3f_random() % 2 ? 'a' : 'A') + _t3f_random() % 26;
+	uint8_t found = t3words_complete(&decoded, prefix, 1 + _t3f_random() % sizeof(prefix), candidates, T3_MAX_CANDIDATES);
+	for(uint8_t i = 0; i < found; ++i) {
+		assert(strlen(candidates[i].text) > candidates[i].replace);
+		for(uint8_t j = 0; j < candidates[i].replace; ++j)
+			assert((candidates[i].text[j] | 0x20) == (prefix[j] | 0x20));
+	}
+}
+
+void _t3f_checkBigram(const T3Bigram * bigram) {
+	// Look up a word of the vocabulary, which a real table usually knows, or
+	// a random one, which only ends at an empty bucket or after all of them
+	char text[T3_MAXLENGTH + 1];
+	uint8_t length = 0;
+	if(_t3f_random() % 2 == 0) {
+		size_t offset = _t3f_random() % bigram->vocabSize;
+		while(offset > 0 && bigram->vocab[offset - 1] != '\0')
+			--offset;
+		while(bigram->vocab[offset] != '\0' && length < T3_MAXLENGTH - 1)
+			text[length++] = bigram->vocab[offset++];
+	} else {
+		uint8_t letters = 1 + _t3f_random() % 8;
+		while(length < letters)
+			text[length++] = 'a' + _t3f_random() % 26;
+	}
+	text[length++] = ' ';
+	text[length] = '\0';
+	
+	T3Candidate candidates[T3_MAX_CANDIDATES];
+	uint8_t found = t3bigram_predict(bigram, text, length, candidates, T3_MAX_CANDIDATES);
+	assert(found <= T3_MAX_CANDIDATES && found <= bigram->next);
+	for(uint8_t i = 0; i < found; ++i) {
+		assert(candidates[i].replace == 0);
+		assert(candidates[i].text >= bigram->vocab && candidates[i].text < bigram->vocab + bigram->vocabSize);
+	}
+}
+
+bool _t3f_loadBigram(const char * path) {
+	FILE * file = fopen(path, "rb");
+	if(file == NULL) {
+		perror(path);
+		return false;
+	}
+	_t3f_bigramSize = fread(_t3f_bigramData, 1, sizeof(_t3f_bigramData), file);
+	fclose(file);
+	
+	T3Bigram bigram;
+	if(!t3bigram_init(&bigram, _t3f_bigramData, _t3f_bigramSize)) {
+		fprintf(stderr, "%s: not a next word table\n", path);
+		return false;
+	}
+	return true;
+}
+
+void _t3f_fillBigram(void) {
+	// Every bucket holds a valid entry, which the table format allows once
+	// the entries are damaged, so a miss probes every bucket
+	static const char vocab[] = "the\0you\0people\0";
+	uint8_t * data = _t3f_fullData;
+	uint16_t entries = _T3F_FULL_BUCKETS - 1;
+	size_t entryBytes = 2 + 3 * T3_BIGRAM_MAX_NEXT;
+	memcpy(data, "T3B", 3);
+	data[3] = 1;
+	data[4] = T3_BIGRAM_MAX_NEXT;
+	data[5] = 0;
+	data[6] = _T3F_FULL_BUCKETS;
+	data[7] = 0;
+	data[8] = entries;
+	data[9] = 0;
+	data[10] = sizeof(vocab);
+	data[11] = 0;
+	
+	uint8_t * buckets = &data[T3_BIGRAM_HEADER_BYTES];
+	for(uint16_t i = 0; i < _T3F_FULL_BUCKETS; ++i) {
+		buckets[2 * i] = i % entries;
+		buckets[2 * i + 1] = 0;
+	}
+	uint8_t * entry = buckets + 2 * _T3F_FULL_BUCKETS;
+	for(uint16_t i = 0; i < entries; ++i, entry += entryBytes) {
+		entry[0] = _t3f_random();
+		entry[1] = _t3f_random();
+		for(uint8_t j = 0; j < T3_BIGRAM_MAX_NEXT; ++j) {
+			static const uint8_t offsets[] = {0, 4, 8};
+			entry[2 + 3 * j] = offsets[(i + j) % 3];
+			entry[3 + 3 * j] = 0;
+			entry[4 + 3 * j] = 16 * j;
+		}
+	}
+	memcpy(entry, vocab, sizeof(vocab));
+	_t3f_fullSize = entry + sizeof(vocab) - data;
+}
+
+void _t3f_damageBigram(const uint8_t * data, size_t size) {
+	// Flip bytes of the buckets and entries only. The header must stay
+	// valid for the table to be used, and the vocabulary is trusted text.
+	memcpy(_t3f_damagedData, data, size);
+	size_t start = T3_BIGRAM_HEADER_BYTES;
+	size_t end = start + 2 * (data[6] | (data[7] << 8))
+		+ (2 + 3 * data[4]) * (data[8] | (data[9] << 8));
+	for(uint8_t flips = 1 + _t3f_random() % 8; flips > 0; --flips)
+		_t3f_damagedData[start + _t3f_random() % (end - start)] ^= 1 + _t3f_random() % 255;
+}
+
+bool _t3f_validText(const char * text, size_t maxBytes) {
+	// Well-formed UTF-8 of at most maxBytes bytes
+	size_t i = 0;
+	while(text[i] != '\0') {
+		uint8_t c = (uint8_t)text[i];
+		uint8_t length = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+		if(length == 0)
+			return false;
+		for(uint8_t j = 1; j < length; ++j)
+			if(((uint8_t)text[i + j] & 0xC0) != 0x80)
+				return false;
+		i += length;
+	}
+	return i <= maxBytes;
+}
+
+void _t3f_corrupt(uint8_t * buffer, size_t * size, size_t capacity) {
+	// Flip a byte, then cut the blob short or pad it with garbage
+	if(*size > 0)
+		buffer[_t3f_random() % *size] ^= 1 + _t3f_random() % 255;
+	uint32_t choice = _t3f_random() % 4;
+	if(choice == 0 && *size > 0)
+		*size = _t3f_random() % *size;
+	else if(choice == 1 && *size < capacity)
+		buffer[(*size)++] = _t3f_random();
+}
+
+uint32_t _t3f_random(void) {
+	// xorshift32, so that a seed always replays the same events
+	_t3f_seed ^= _t3f_seed << 13;
+	_t3f_seed ^= _t3f_seed >> 17;
+	_t3f_seed ^= _t3f_seed << 5;
+	return _t3f_seed;
+}
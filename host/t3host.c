@@ -0,0 +1,560 @@
+/*******************************************************************************
+ * T3 Keyboard v1.0
+ *
+ * Copyright 2014 Chris Nucci (t3@fourbyte.com)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ******************************************************************************/
+
+/**
+ * A terminal backend for the T3 keyboard core, for running and profiling the
+ * input engine on a desktop machine without the Pebble SDK.
+ *
+ * Build:
+ *   cc -std=c99 -O2 -DT3_COLLECT_STATS=1 -I. -o t3host host/t3host.c T3Core.c T3Mru.c T3Snippets.c T3Words.c T3Bigram.c
+ *
+ * Usage:
+ *   t3host             Reads commands from stdin and draws the keyboard
+ *                      after each one.
+ *   t3host -b COUNT    Drives COUNT random commands through the core and
+ *                      reports the command rate.
+ *   t3host -c FILE     Types the text in FILE in each entry mode, pressing
+ *                      the fewest buttons, and compares the characters
+ *                      entered per second of virtual time.
+ *   -s FILE            Loads snippets from FILE, in the format of
+ *                      t3window_load_snippets(), before any mode.
+ *   -w FILE            Completes words from the dictionary in FILE, one
+ *                      word per line, most frequent first.
+ *   -g FILE            Predicts next words from the table in FILE, as
+ *                      written by t3bigram.
+ *   -2                 Uses T3_ENTRY_TWO_STEP instead of multi-tap.
+ *   -i                 Expands the initials of recent texts like snippets.
+ *
+ * Commands are single characters. Each one takes _T3H_PRESS_INTERVAL_IN_MS
+ * of virtual time, so a pending key times out after a few idle commands.
+ * As on the watch, each command is handled as soon as it arrives, and what
+ * it invalidated is drawn on the next frame, at most once per
+ * _T3H_FRAME_INTERVAL_IN_MS:
+ *   u s d   Click UP, SELECT or DOWN
+ *   U S D   Long click UP, SELECT or DOWN
+ *   b       Back
+ *   x       Backspace
+ *   k       Kill and resume: snapshot the core, start afresh and restore it
+ *   .       Wait without pressing anything
+ *
+ * Closing the keyboard adds the text to an in-memory list of recent texts
+ * and opens it again with no text, as an app would. The words of recent
+ * texts are learned for completion, and with -i their initials are
+ * expanded like snippets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "T3Core.h"
+#include "T3Mru.h"
+#include "T3Snippets.h"
+#include "T3Words.h"
+#include "T3Bigram.h"
+
+#define _T3H_PRESS_INTERVAL_IN_MS 200
+#define _T3H_FRAME_INTERVAL_IN_MS 33
+#define _T3H_MAX_SNIPPET_BYTES 4096
+#define _T3H_MAX_PLAN 32
+#define _T3H_MAX_DICTIONARY_BYTES 65536
+#define _T3H_MAX_BIGRAM_BYTES 65536
+
+typedef struct _t3h_Host {
+	T3Core core;
+	T3Mru mru;
+	T3Snippets snippets;
+	T3Words words;
+	uint32_t now;
+	bool timerArmed;
+	uint32_t timerDeadline;
+	bool quiet;
+	uint8_t dirty;
+	uint32_t dirtyKeys;
+	uint32_t frameTime;
+	uint32_t closes;
+} _t3h_Host;
+
+const char * _t3h_set1[] = {T3_LAYOUT_LOWERCASE, T3_LAYOUT_UPPERCASE};
+const char * _t3h_set2[] = {T3_LAYOUT_NUMBERS};
+const char * _t3h_set3[] = {T3_LAYOUT_PUNC, T3_LAYOUT_BRACKETS};
+const char ** _t3h_sets[] = {_t3h_set1, _t3h_set2, _t3h_set3};
+const uint8_t _t3h_counts[] = {2, 1, 2};
+char _t3h_snippetData[_T3H_MAX_SNIPPET_BYTES];
+size_t _t3h_snippetSize = 0;
+char _t3h_dictionary[_T3H_MAX_DICTIONARY_BYTES + 1];
+bool _t3h_hasDictionary = false;
+uint8_t _t3h_entryMode = T3_ENTRY_MULTITAP;
+bool _t3h_learnInitials = false;
+uint8_t _t3h_bigramData[_T3H_MAX_BIGRAM_BYTES];
+T3Bigram _t3h_bigram;
+bool _t3h_hasBigram = false;
+
+void _t3h_init(_t3h_Host * host, bool quiet);
+void _t3h_post(_t3h_Host * host, uint8_t type, uint8_t button);
+void _t3h_advance(_t3h_Host * host, uint32_t ms);
+void _t3h_dispatch(_t3h_Host * host);
+void _t3h_frame(_t3h_Host * host);
+void _t3h_render(const _t3h_Host * host);
+bool _t3h_command(_t3h_Host * host, char command);
+void _t3h_resume(_t3h_Host * host);
+void _t3h_report(const _t3h_Host * host);
+bool _t3h_loadSnippets(const char * path);
+bool _t3h_loadDictionary(const char * path);
+bool _t3h_loadBigram(const char * path);
+bool _t3h_findKey(const char * layout, const char * c, uint8_t length,
+				  uint8_t * rows, uint8_t * cols, uint8_t * key, uint8_t * index);
+uint8_t _t3h_plan(const _t3h_Host * host, const char * c, uint8_t length, char * commands);
+int _t3h_interactive(void);
+int _t3h_benchmark(unsigned long count);
+int _t3h_corpus(const char * path);
+
+int main(int argc, char ** argv) {
+	int arg = 1;
+	for(;;) {
+		if(arg + 1 < argc && strcmp(argv[arg], "-s") == 0) {
+			if(!_t3h_loadSnippets(argv[arg + 1]))
+				return 1;
+			arg += 2;
+		} else if(arg + 1 < argc && strcmp(argv[arg], "-w") == 0) {
+			if(!_t3h_loadDictionary(argv[arg + 1]))
+				return 1;
+			arg += 2;
+		} else if(arg + 1 < argc && strcmp(argv[arg], "-g") == 0) {
+			if(!_t3h_loadBigram(argv[arg + 1]))
+				return 1;
+			arg += 2;
+		} else if(arg < argc && strcmp(argv[arg], "-2") == 0) {
+			_t3h_entryMode = T3_ENTRY_TWO_STEP;
+			++arg;
+		} else if(arg < argc && strcmp(argv[arg], "-i") == 0) {
+			_t3h_learnInitials = true;
+			++arg;
+		} else
+			break;
+	}
+	
+	if(arg + 2 == argc && strcmp(argv[arg], "-b") == 0)
+		return _t3h_benchmark(strtoul(argv[arg + 1], NULL, 10));
+	else if(arg + 2 == argc && strcmp(argv[arg], "-c") == 0)
+		return _t3h_corpus(argv[arg + 1]);
+	else if(arg == argc)
+		return _t3h_interactive();
+
+	fprintf(stderr, "usage: %s [-s FILE] [-w FILE] [-g FILE] [-2] [-i] [-b COUNT | -c FILE]\n", argv[0]);
+	return 1;
+}
+
+void _t3h_init(_t3h_Host * host, bool quiet) {
+	t3core_init(&host->core, _t3h_set1, 2, _t3h_set2, 1, _t3h_set3, 2);
+	t3mru_init(&host->mru);
+	t3core_set_mru(&host->core, &host->mru);
+	t3snippets_init(&host->snippets);
+	t3snippets_add_packed(&host->snippets, _t3h_snippetData, _t3h_snippetSize);
+	t3snippets_set_learning(&host->snippets, _t3h_learnInitials);
+	t3core_set_snippets(&host->core, &host->snippets);
+	t3words_init(&host->words);
+	t3words_set_dictionary(&host->words, _t3h_hasDictionary ? _t3h_dictionary : NULL);
+	t3core_set_words(&host->core, &host->words);
+	t3core_set_bigram(&host->core, _t3h_hasBigram ? &_t3h_bigram : NULL);
+	t3core_set_entry_mode(&host->core, _t3h_entryMode);
+	host->now = 0;
+	host->timerArmed = false;
+	host->timerDeadline = 0;
+	host->quiet = quiet;
+	host->dirty = 0;
+	host->dirtyKeys = 0;
+	host->frameTime = -_T3H_FRAME_INTERVAL_IN_MS;
+	host->closes = 0;
+}
+
+void _t3h_post(_t3h_Host * host, uint8_t type, uint8_t button) {
+	// Each press and timer firing is a callback of its own on the watch
+	_T3_COUNT(&host->core, wakeups);
+	t3core_post(&host->core, type, button, host->now);
+	_t3h_dispatch(host);
+}
+
+void _t3h_advance(_t3h_Host * host, uint32_t ms) {
+	// Fire the virtual timer at its deadline, as the watch would
+	uint32_t end = host->now + ms;
+	while(host->timerArmed && (int32_t)(host->timerDeadline - end) <= 0) {
+		host->now = host->timerDeadline;
+		host->timerArmed = false;
+		_t3h_post(host, T3_EVENT_TIMEOUT, 0);
+		_t3h_frame(host);
+	}
+	host->now = end;
+	_t3h_frame(host);
+}
+
+void _t3h_dispatch(_t3h_Host * host) {
+	T3Effects effects;
+	do {
+		t3core_run(&host->core, &effects);
+		host->dirty |= effects.dirty;
+		host->dirtyKeys |= effects.dirtyKeys;
+		
+		if(effects.timerWanted && !host->timerArmed) {
+			host->timerArmed = true;
+			host->timerDeadline = effects.deadline;
+			_T3_COUNT(&host->core, timerOps);
+		} else if(!effects.timerWanted && host->timerArmed) {
+			host->timerArmed = false;
+			_T3_COUNT(&host->core, timerOps);
+		}
+		
+		if(effects.close) {
+			++(host->closes);
+			if(!host->quiet)
+				printf("Closed with \"%s\"\n", t3core_get_text(&host->core));
+			
+			// The app opens the keyboard again, which the window sees appear
+			t3core_set_text(&host->core, "");
+			_T3_COUNT(&host->core, wakeups);
+			t3core_post(&host->core, T3_EVENT_OPEN, 0, host->now);
+		}
+	} while(host->core.eventCount > 0);
+}
+
+void _t3h_frame(_t3h_Host * host) {
+	// The watch draws the layers marked dirty once per frame, however often
+	// they were marked, so count the layers of each frame as the Pebble
+	// backend counts them in its draw procs
+	if(host->dirty == 0 && host->dirtyKeys == 0)
+		return;
+	if(host->now - host->frameTime < _T3H_FRAME_INTERVAL_IN_MS)
+		return;
+	
+	uint8_t parts = 0;
+	if(host->dirty & (T3_DIRTY_KEYS | T3_DIRTY_GRID))
+		parts = 1 + host->core.rows * host->core.cols;
+	else {
+		if(host->dirty & T3_DIRTY_INPUT)
+			++parts;
+		for(uint32_t keys = host->dirtyKeys; keys != 0; keys &= keys - 1)
+			++parts;
+	}
+	#if T3_COLLECT_STATS
+	host->core.stats.redraws += parts;
+	#endif
+	
+	host->dirty = 0;
+	host->dirtyKeys = 0;
+	host->frameTime = host->now;
+	if(parts > 0 && !host->quiet)
+		_t3h_render(host);
+}
+
+void _t3h_render(const _t3h_Host * host) {
+	printf("[%s]\n", t3core_get_text(&host->core));
+	if(t3core_is_picking(&host->core)) {
+		for(uint8_t i = 0; i < T3_MAX_CANDIDATES; ++i) {
+			const char * text = t3core_get_candidate(&host->core, i);
+			printf(" %c) %s\n", "usd"[i], text != NULL ? text : "");
+		}
+		printf("\n");
+		return;
+	} else if(t3core_get_candidate_count(&host->core) > 0)
+		printf("  (b: %s)\n", t3core_get_candidate(&host->core, 0));
+	for(uint8_t r = 1; r <= host->core.rows; ++r) {
+		for(uint8_t c = 1; c <= host->core.cols; ++c) {
+			const char * text = t3core_get_key_text(&host->core, r, c);
+			bool pressed = t3core_is_key_pressed(&host->core, r, c);
+			printf("%c%-4s%c", pressed ? '[' : ' ', text != NULL ? text : "", pressed ? ']' : ' ');
+		}
+		printf("\n");
+	}
+	printf("\n");
+}
+
+bool _t3h_command(_t3h_Host * host, char command) {
+	switch(command) {
+		case 'u': _t3h_post(host, T3_EVENT_CLICK, T3_BUTTON_UP); break;
+		case 's': _t3h_post(host, T3_EVENT_CLICK, T3_BUTTON_SELECT); break;
+		case 'd': _t3h_post(host, T3_EVENT_CLICK, T3_BUTTON_DOWN); break;
+		case 'U': _t3h_post(host, T3_EVENT_LONGCLICK, T3_BUTTON_UP); break;
+		case 'S': _t3h_post(host, T3_EVENT_LONGCLICK, T3_BUTTON_SELECT); break;
+		case 'D': _t3h_post(host, T3_EVENT_LONGCLICK, T3_BUTTON_DOWN); break;
+		case 'b': _t3h_post(host, T3_EVENT_BACK, 0); break;
+		case 'x': _t3h_post(host, T3_EVENT_BACKSPACE, 0); break;
+		case 'k': _t3h_resume(host); break;
+		case '.': break;
+		default: return false;
+	}
+	_t3h_frame(host);
+	_t3h_advance(host, _T3H_PRESS_INTERVAL_IN_MS);
+	return true;
+}
+
+void _t3h_resume(_t3h_Host * host) {
+	uint8_t blob[T3_SNAPSHOT_MAX_BYTES];
+	size_t size = t3core_snapshot(&host->core, host->now, blob, sizeof(blob));
+	
+	#if T3_COLLECT_STATS
+	T3Stats stats = host->core.stats;
+	#endif
+	t3core_init(&host->core, _t3h_set1, 2, _t3h_set2, 1, _t3h_set3, 2);
+	t3core_set_mru(&host->core, &host->mru);
+	t3core_set_snippets(&host->core, &host->snippets);
+	t3core_set_words(&host->core, &host->words);
+	t3core_set_bigram(&host->core, _t3h_hasBigram ? &_t3h_bigram : NULL);
+	t3core_set_entry_mode(&host->core, _t3h_entryMode);
+	#if T3_COLLECT_STATS
+	host->core.stats = stats;
+	#endif
+	
+	// The timer died with the app; restoring asks for it again
+	host->timerArmed = false;
+	if(size > 0)
+		t3core_restore(&host->core, host->now, blob, size);
+	if(!host->quiet)
+		printf("Resumed from %lu bytes\n", (unsigned long)size);
+	_t3h_post(host, T3_EVENT_OPEN, 0);
+}
+
+void _t3h_report(const _t3h_Host * host) {
+	#if T3_COLLECT_STATS
+	const T3Stats * stats = &host->core.stats;
+	double commits = stats->commits > 0 ? stats->commits : 1;
+	printf("commits   %10lu\n", (unsigned long)stats->commits);
+	printf("wakeups   %10lu  %6.2f per char\n", (unsigned long)stats->wakeups, stats->wakeups / commits);
+	printf("timer ops %10lu  %6.2f per char\n", (unsigned long)stats->timerOps, stats->timerOps / commits);
+	printf("redraws   %10lu  %6.2f per char\n", (unsigned long)stats->redraws, stats->redraws / commits);
+	#else
+	(void)host;
+	printf("(build with -DT3_COLLECT_STATS=1 to count)\n");
+	#endif
+}
+
+bool _t3h_loadSnippets(const char * path) {
+	FILE * file = fopen(path, "rb");
+	if(file == NULL) {
+		perror(path);
+		return false;
+	}
+	_t3h_snippetSize = fread(_t3h_snippetData, 1, sizeof(_t3h_snippetData) - 1, file);
+	fclose(file);
+	return true;
+}
+
+bool _t3h_loadDictionary(const char * path) {
+	FILE * file = fopen(path, "rb");
+	if(file == NULL) {
+		perror(path);
+		return false;
+	}
+	size_t size = fread(_t3h_dictionary, 1, _T3H_MAX_DICTIONARY_BYTES - 1, file);
+	fclose(file);
+	
+	// One word per line becomes the packed format, ended by an empty word
+	for(size_t i = 0; i < size; ++i)
+		if(_t3h_dictionary[i] == '\n' || _t3h_dictionary[i] == '\r')
+			_t3h_dictionary[i] = '\0';
+	_t3h_dictionary[size] = '\0';
+	_t3h_dictionary[size + 1] = '\0';
+	_t3h_hasDictionary = true;
+	return true;
+}
+
+bool _t3h_loadBigram(const char * path) {
+	FILE * file = fopen(path, "rb");
+	if(file == NULL) {
+		perror(path);
+		return false;
+	}
+	size_t size = fread(_t3h_bigramData, 1, sizeof(_t3h_bigramData), file);
+	fclose(file);
+	
+	if(!t3bigram_init(&_t3h_bigram, _t3h_bigramData, size)) {
+		fprintf(stderr, "%s: not a next word table\n", path);
+		return false;
+	}
+	_t3h_hasBigram = true;
+	return true;
+}
+
+int _t3h_interactive(void) {
+	_t3h_Host host;
+	_t3h_init(&host, false);
+	_t3h_render(&host);
+
+	int c;
+	while((c = getchar()) != EOF)
+		_t3h_command(&host, (char)c);
+
+	// Let a pending key time out before reporting
+	_t3h_advance(&host, 10 * _T3H_PRESS_INTERVAL_IN_MS);
+	_t3h_report(&host);
+	return 0;
+}
+
+int _t3h_benchmark(unsigned long count) {
+	static const char commands[] = "uuusssdddu.s.d..bxUSDk";
+	_t3h_Host host;
+	_t3h_init(&host, true);
+
+	srand(3);
+	clock_t start = clock();
+	for(unsigned long i = 0; i < count; ++i)
+		_t3h_command(&host, commands[rand() % (sizeof(commands) - 1)]);
+	double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("commands  %10lu  %.0f per second\n", count, seconds > 0 ? count / seconds : 0);
+	printf("closes    %10lu\n", (unsigned long)host.closes);
+	_t3h_report(&host);
+	return 0;
+}
+
+bool _t3h_findKey(const char * layout, const char * c, uint8_t length,
+				  uint8_t * rows, uint8_t * cols, uint8_t * key, uint8_t * index) {
+	*rows = 3;
+	*cols = 3;
+	if(layout[0] > '\0' && layout[0] < ' ') {
+		*rows = layout[0];
+		*cols = layout[1];
+		layout += 2;
+	}
+	
+	for(*key = 0; *key < *rows * *cols; ++(*key)) {
+		for(*index = 0; *layout != '\0'; ++(*index)) {
+			// Advance by whole UTF-8 characters
+			uint8_t charLength = 1;
+			while((layout[charLength] & 0xC0) == 0x80)
+				++charLength;
+			if(charLength == length && memcmp(layout, c, length) == 0)
+				return true;
+			layout += charLength;
+		}
+		++layout;
+	}
+	return false;
+}
+
+uint8_t _t3h_plan(const _t3h_Host * host, const char * c, uint8_t length, char * commands) {
+	// Prefer the current keyboard, then look through the sets in order
+	uint8_t set = host->core.set;
+	uint8_t kb = host->core.kb;
+	uint8_t rows, cols, key, index;
+	if(!_t3h_findKey(_t3h_sets[set][kb], c, length, &rows, &cols, &key, &index)) {
+		bool found = false;
+		for(set = 0; set < 3 && !found; ++set)
+			for(kb = 0; kb < _t3h_counts[set] && !found; ++kb)
+				found = _t3h_findKey(_t3h_sets[set][kb], c, length, &rows, &cols, &key, &index);
+		if(!found)
+			return 0;
+		--set;
+		--kb;
+	}
+	
+	uint8_t count = 0;
+	if(host->core.inputLength + length > T3_MAXLENGTH)
+		commands[count++] = 'b';
+	
+	// Long clicks select a set and then cycle through its keyboards
+	uint8_t current = host->core.set == set ? host->core.kb : _t3h_counts[set];
+	while(current != kb) {
+		commands[count++] = "USD"[set];
+		current = current + 1 < _t3h_counts[set] ? current + 1 : 0;
+	}
+	
+	uint8_t row = key / cols + 1;
+	uint8_t col = key % cols + 1;
+	uint8_t button = 1;
+	while(button < 3 && row >= button * rows / 3 + 1)
+		++button;
+	if(host->core.entryMode == T3_ENTRY_TWO_STEP && rows == 3 && cols <= 3) {
+		commands[count++] = "usd"[row - 1];
+		commands[count++] = "usd"[col - 1];
+	} else {
+		// Press through the keys of the row group, then wait for the timeout
+		uint8_t presses = (row - ((button - 1) * rows / 3 + 1)) * cols + col;
+		while(presses-- > 0)
+			commands[count++] = "usd"[button - 1];
+		commands[count++] = '.';
+		commands[count++] = '.';
+	}
+	
+	// A key of several characters opens the selection view
+	const char * layout = _t3h_sets[set][kb];
+	if(layout[0] > '\0' && layout[0] < ' ')
+		layout += 2;
+	for(uint8_t k = 0; k < key; ++k)
+		layout += strlen(layout) + 1;
+	if(strlen(layout) > length)
+		commands[count++] = "usd"[index];
+	return count;
+}
+
+int _t3h_corpus(const char * path) {
+	static char text[1 << 16];
+	FILE * file = fopen(path, "rb");
+	if(file == NULL) {
+		perror(path);
+		return 1;
+	}
+	size_t size = fread(text, 1, sizeof(text) - 1, file);
+	fclose(file);
+	text[size] = '\0';
+	
+	printf("mode       presses/char  chars/sec  wakeups/char  timer ops/char  redraws/char\n");
+	static const uint8_t modes[] = {T3_ENTRY_MULTITAP, T3_ENTRY_TWO_STEP};
+	static const char * names[] = {"multi-tap", "two-step"};
+	for(uint8_t m = 0; m < 2; ++m) {
+		// Candidates and snippets would skip keystrokes, so leave them out
+		_t3h_Host host;
+		_t3h_entryMode = modes[m];
+		_t3h_init(&host, true);
+		t3core_set_mru(&host.core, NULL);
+		t3core_set_snippets(&host.core, NULL);
+		t3core_set_words(&host.core, NULL);
+		t3core_set_bigram(&host.core, NULL);
+		
+		unsigned long presses = 0, typed = 0, skipped = 0;
+		for(size_t i = 0; i < size; ) {
+			uint8_t length = 1;
+			while((text[i + length] & 0xC0) == 0x80)
+				++length;
+			
+			char commands[_T3H_MAX_PLAN];
+			uint8_t count = _t3h_plan(&host, &text[i], length, commands);
+			if(count == 0)
+				++skipped;
+			else
+				++typed;
+			for(uint8_t j = 0; j < count; ++j) {
+				_t3h_command(&host, commands[j]);
+				if(commands[j] != '.')
+					++presses;
+			}
+			i += length;
+		}
+		
+		double seconds = host.now / 1000.0;
+		printf("%-10s %12.2f %10.2f", names[m], (double)presses / typed, typed / seconds);
+		#if T3_COLLECT_STATS
+		double commits = host.core.stats.commits > 0 ? host.core.stats.commits : 1;
+		printf(" %13.2f %15.2f %13.2f", host.core.stats.wakeups / commits,
+			host.core.stats.timerOps / commits, host.core.stats.redraws / commits);
+		#endif
+		printf("\n");
+		if(skipped > 0)
+			printf("           %lu characters not on any keyboard were skipped\n", skipped);
+	}
+	return 0;
+}